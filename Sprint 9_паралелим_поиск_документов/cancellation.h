@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Бросается из поиска, отменённого через CancellationToken
+class QueryCancelled : public runtime_error {
+public:
+    QueryCancelled()
+        : runtime_error("Query cancelled"s) {
+    }
+};
+
+// Флаг отмены запроса. Копии токена делят один флаг, поэтому его можно
+// передать в запрос и отменить из другого потока.
+// Токен, созданный конструктором по умолчанию, отменить нельзя, и проверка его ничего не стоит
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    static CancellationToken Create() {
+        CancellationToken token;
+        token.cancelled_ = make_shared<atomic<bool>>(false);
+        return token;
+    }
+
+    void Cancel() const {
+        if (cancelled_) {
+            cancelled_->store(true, memory_order_relaxed);
+        }
+    }
+
+    bool IsCancelled() const {
+        return cancelled_ && cancelled_->load(memory_order_relaxed);
+    }
+
+    void ThrowIfCancelled() const {
+        if (IsCancelled()) {
+            throw QueryCancelled();
+        }
+    }
+
+private:
+    shared_ptr<atomic<bool>> cancelled_;
+};
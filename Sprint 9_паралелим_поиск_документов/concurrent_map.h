@@ -1,17 +1,22 @@
 #pragma once
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <future>
 #include <map>
 #include <numeric>
 #include <random>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <mutex>
  
  
 using namespace std::string_literals;
 using namespace std;
+
+// Размер строки кэша: данные, которые меняют разные потоки, разносятся по разным строкам
+const size_t CACHE_LINE_SIZE = 64;
  
 template <typename Key, typename Value>
 class ConcurrentMap {
@@ -29,33 +34,37 @@ public:
         }
     };
  
-    explicit ConcurrentMap(size_t bucket_count): dictionary_(bucket_count),
-                                                 m_(bucket_count){}
+    explicit ConcurrentMap(size_t bucket_count): buckets_(bucket_count){}
     Access operator[](const Key& key){
-        uint64_t index = (uint64_t)key%dictionary_.size();
-        return {key, m_[index], dictionary_[index]};
+        Bucket& bucket = buckets_[(uint64_t)key%buckets_.size()];
+        return {key, bucket.m, bucket.dictionary};
     };
  
  
     std::map<Key, Value> BuildOrdinaryMap(){
         map<Key, Value> all_dictionary_;
-        for(size_t i = 0;  i < dictionary_.size(); ++i){
-            lock_guard<mutex> guard(m_[i]);
-            for(auto it = dictionary_[i].begin(); it != dictionary_[i].end(); ++it){
+        for(Bucket& bucket : buckets_){
+            lock_guard<mutex> guard(bucket.m);
+            for(auto it = bucket.dictionary.begin(); it != bucket.dictionary.end(); ++it){
                 all_dictionary_[it->first] = it ->second;
             }
         } 
         return all_dictionary_;
     };
     
-    void erase(int document_id){
-        uint64_t index = (uint64_t)document_id%dictionary_.size();
-        dictionary_[index].erase(document_id); 
+    void erase(const Key& key){
+        Bucket& bucket = buckets_[(uint64_t)key%buckets_.size()];
+        lock_guard<mutex> guard(bucket.m);
+        bucket.dictionary.erase(key); 
     };
  
  
 private:
-    vector<map<Key, Value>> dictionary_{};
-    vector<mutex> m_{};
+    // мьютекс лежит рядом со своей корзиной, и соседние корзины не делят строку кэша
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        mutex m;
+        map<Key, Value> dictionary;
+    };
+
+    vector<Bucket> buckets_{};
 };
- 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -21,13 +23,23 @@ struct Document {
 };
 
 
-enum class DocumentStatus {
+enum class DocumentStatus : uint8_t {
     ACTUAL,
     IRRELEVANT,
     BANNED,
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Документ для пакетного добавления в SearchServer::AddDocuments. Текст должен жить до конца вызова
+struct NewDocument {
+    int id = 0;
+    string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+};
+
 ostream& operator<<(ostream& out, const Document& document);
 
 
@@ -0,0 +1,45 @@
+#include "document_columns.h"
+#include "index_snapshot.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t DocumentColumns::Append(int document_id, DocumentStatus status, int rating, double inv_word_count, uint64_t text_offset, uint32_t text_length) {
+    const uint32_t ordinal = static_cast<uint32_t>(ids_.size());
+    ids_.Mutable().push_back(document_id);
+    statuses_.Mutable().push_back(status);
+    ratings_.Mutable().push_back(rating);
+    inv_word_counts_.Mutable().push_back(inv_word_count);
+    text_offsets_.Mutable().push_back(text_offset);
+    text_lengths_.Mutable().push_back(text_length);
+    return ordinal;
+}
+
+void DocumentColumns::SetText(uint32_t ordinal, uint64_t text_offset, uint32_t text_length) {
+    text_offsets_.Mutable()[ordinal] = text_offset;
+    text_lengths_.Mutable()[ordinal] = text_length;
+}
+
+void DocumentColumns::Save(SnapshotWriter& writer) const {
+    writer.WriteSection(SnapshotSection::DOCUMENT_IDS, ids_.data(), ids_.size());
+    writer.WriteSection(SnapshotSection::DOCUMENT_STATUSES, statuses_.data(), statuses_.size());
+    writer.WriteSection(SnapshotSection::DOCUMENT_RATINGS, ratings_.data(), ratings_.size());
+    writer.WriteSection(SnapshotSection::DOCUMENT_INV_WORD_COUNTS, inv_word_counts_.data(), inv_word_counts_.size());
+    writer.WriteSection(SnapshotSection::DOCUMENT_TEXT_OFFSETS, text_offsets_.data(), text_offsets_.size());
+    writer.WriteSection(SnapshotSection::DOCUMENT_TEXT_LENGTHS, text_lengths_.data(), text_lengths_.size());
+}
+
+void DocumentColumns::Load(const SnapshotReader& reader) {
+    ids_ = reader.GetArray<int, AlignedAllocator<int>>(SnapshotSection::DOCUMENT_IDS);
+    statuses_ = reader.GetArray<DocumentStatus, AlignedAllocator<DocumentStatus>>(SnapshotSection::DOCUMENT_STATUSES);
+    ratings_ = reader.GetArray<int, AlignedAllocator<int>>(SnapshotSection::DOCUMENT_RATINGS);
+    inv_word_counts_ = reader.GetArray<double, AlignedAllocator<double>>(SnapshotSection::DOCUMENT_INV_WORD_COUNTS);
+    text_offsets_ = reader.GetArray<uint64_t, AlignedAllocator<uint64_t>>(SnapshotSection::DOCUMENT_TEXT_OFFSETS);
+    text_lengths_ = reader.GetArray<uint32_t, AlignedAllocator<uint32_t>>(SnapshotSection::DOCUMENT_TEXT_LENGTHS);
+    const size_t count = ids_.size();
+    if (statuses_.size() != count || ratings_.size() != count || inv_word_counts_.size() != count || text_offsets_.size() != count
+        || text_lengths_.size() != count) {
+        throw runtime_error("Snapshot document columns are inconsistent"s);
+    }
+}
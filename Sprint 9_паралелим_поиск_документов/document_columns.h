@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "document.h"
+#include "mapped_array.h"
+
+using namespace std;
+
+// Аллокатор, выравнивающий начало массива по границе кэш-линии
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {
+    }
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), align_val_t{Alignment}));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        ::operator delete(pointer, align_val_t{Alignment});
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedArray = MappedArray<T, AlignedAllocator<T>>;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Метаданные документов по столбцам: предикат читает только нужные ему байты,
+// а не всю запись вместе с текстом
+class DocumentColumns {
+public:
+    uint32_t Append(int document_id, DocumentStatus status, int rating, double inv_word_count, uint64_t text_offset, uint32_t text_length);
+
+    int GetId(uint32_t ordinal) const {
+        return ids_[ordinal];
+    }
+
+    DocumentStatus GetStatus(uint32_t ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    int GetRating(uint32_t ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    double GetInvWordCount(uint32_t ordinal) const {
+        return inv_word_counts_[ordinal];
+    }
+
+    // Адрес текста документа в TextArena
+    uint64_t GetTextOffset(uint32_t ordinal) const {
+        return text_offsets_[ordinal];
+    }
+
+    uint32_t GetTextLength(uint32_t ordinal) const {
+        return text_lengths_[ordinal];
+    }
+
+    void SetText(uint32_t ordinal, uint64_t text_offset, uint32_t text_length);
+
+    size_t size() const {
+        return ids_.size();
+    }
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Столбцы остаются в отображённом файле до первого добавления документа.
+    // Бросает runtime_error, если длины столбцов различаются
+    void Load(const SnapshotReader& reader);
+
+private:
+    AlignedArray<int> ids_;
+    AlignedArray<DocumentStatus> statuses_;
+    AlignedArray<int> ratings_;
+    AlignedArray<double> inv_word_counts_;
+    AlignedArray<uint64_t> text_offsets_;
+    AlignedArray<uint32_t> text_lengths_;
+};
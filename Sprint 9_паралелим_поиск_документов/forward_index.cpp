@@ -0,0 +1,41 @@
+#include "forward_index.h"
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void ForwardIndex::Append(const vector<TermCount>& terms) {
+    auto& all_terms = terms_.Mutable();
+    all_terms.insert(all_terms.end(), terms.begin(), terms.end());
+    offsets_.Mutable().push_back(all_terms.size());
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    if (!terms_checked_) {
+        CheckTerms({terms_.data(), terms_.data() + terms_.size()});
+    }
+    writer.WriteSection(SnapshotSection::FORWARD_OFFSETS, offsets_.data(), offsets_.size());
+    writer.WriteSection(SnapshotSection::FORWARD_TERMS, terms_.data(), terms_.size());
+}
+
+void ForwardIndex::Load(const SnapshotReader& reader, size_t term_count, bool checksum_verified) {
+    const auto offsets = reader.GetArray<uint64_t>(SnapshotSection::FORWARD_OFFSETS);
+    const auto terms = reader.GetArray<TermCount>(SnapshotSection::FORWARD_TERMS);
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != terms.size() || !is_sorted(offsets.begin(), offsets.end())) {
+        throw runtime_error("Snapshot forward index is corrupted"s);
+    }
+    offsets_ = offsets;
+    terms_ = terms;
+    terms_checked_ = checksum_verified;
+    term_count_ = term_count;
+}
+
+void ForwardIndex::CheckTerms(IteratorRange<const TermCount*> terms) const {
+    for (const TermCount& term : terms) {
+        if (term.term_id >= term_count_) {
+            throw runtime_error("Snapshot forward index is corrupted"s);
+        }
+    }
+}
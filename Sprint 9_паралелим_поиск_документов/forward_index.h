@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "mapped_array.h"
+#include "paginator.h"
+#include "term_dictionary.h"
+
+using namespace std;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Прямой индекс: слова каждого документа, отсортированные по номеру слова.
+// Все списки лежат подряд в одном массиве, границы документов хранятся отдельно
+class ForwardIndex {
+public:
+    ForwardIndex()
+        : offsets_(1, 0) {
+    }
+
+    void Append(const vector<TermCount>& terms);
+
+    // Бросает runtime_error, если в документе из непроверенного снимка номер слова выходит за словарь
+    IteratorRange<const TermCount*> operator[](uint32_t ordinal) const {
+        const IteratorRange<const TermCount*> terms{terms_.data() + offsets_[ordinal], terms_.data() + offsets_[ordinal + 1]};
+        if (!terms_checked_) {
+            CheckTerms(terms);
+        }
+        return terms;
+    }
+
+    size_t size() const {
+        return offsets_.size() - 1;
+    }
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Бросает runtime_error, если границы документов выходят за массив слов. Номера слов сверяются
+    // с term_count, только если контрольная сумма файла не проверена, и по одному документу при чтении
+    void Load(const SnapshotReader& reader, size_t term_count, bool checksum_verified);
+
+private:
+    MappedArray<uint64_t> offsets_;
+    MappedArray<TermCount> terms_;
+    // номера слов из непроверенного снимка сверяются с размером словаря term_count_
+    bool terms_checked_ = true;
+    size_t term_count_ = 0;
+
+    void CheckTerms(IteratorRange<const TermCount*> terms) const;
+};
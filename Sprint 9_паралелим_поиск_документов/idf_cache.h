@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+#include "term_dictionary.h"
+
+using namespace std;
+
+// IDF слова меняется только при добавлении и удалении документов, поэтому
+// значение считается один раз и живёт, пока не сменилась эпоха индекса.
+// Чтение безопасно из нескольких потоков: гонка возможна только между потоками,
+// которые вычисляют одно и то же значение для одной эпохи
+class IdfCache {
+public:
+    IdfCache() = default;
+
+    // копия получает пустой кэш того же размера
+    IdfCache(const IdfCache& other) {
+        Resize(other.entries_.size());
+    }
+
+    IdfCache& operator=(const IdfCache& other) {
+        entries_.clear();
+        Resize(other.entries_.size());
+        return *this;
+    }
+
+    IdfCache(IdfCache&&) = default;
+    IdfCache& operator=(IdfCache&&) = default;
+
+    void Resize(size_t term_count) {
+        while (entries_.size() < term_count) {
+            entries_.emplace_back();
+        }
+    }
+
+    template <typename Compute>
+    double Get(TermId term_id, uint64_t epoch, Compute compute) const {
+        Entry& entry = entries_[term_id];
+        if (entry.epoch.load(memory_order_acquire) == epoch) {
+            return entry.value.load(memory_order_relaxed);
+        }
+        const double value = compute();
+        entry.value.store(value, memory_order_relaxed);
+        entry.epoch.store(epoch, memory_order_release);
+        return value;
+    }
+
+private:
+    struct Entry {
+        atomic<uint64_t> epoch{0};
+        atomic<double> value{0.0};
+    };
+
+    // deque не перемещает элементы при росте, а atomic перемещать нельзя
+    mutable deque<Entry> entries_;
+};
@@ -0,0 +1,214 @@
+#include "index_snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const size_t SECTION_ALIGNMENT = 64;
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t table_offset;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(SnapshotHeader) == SECTION_ALIGNMENT);
+
+uint64_t UpdateChecksum(uint64_t checksum, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        checksum = (checksum ^ bytes[i]) * FNV_PRIME;
+    }
+    return checksum;
+}
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp"s)
+    , out_(temporary_path_, ios::binary | ios::trunc)
+    , checksum_(FNV_OFFSET_BASIS) {
+    if (!out_) {
+        throw runtime_error("Cannot create snapshot "s + temporary_path_);
+    }
+    const SnapshotHeader placeholder{};
+    out_.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+    offset_ = sizeof(placeholder);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!finished_) {
+        out_.close();
+        remove(temporary_path_.c_str());
+    }
+}
+
+void SnapshotWriter::WriteRaw(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    checksum_ = UpdateChecksum(checksum_, data, size);
+    offset_ += size;
+}
+
+void SnapshotWriter::Align(size_t alignment) {
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    const size_t remainder = static_cast<size_t>(offset_ % alignment);
+    if (remainder != 0) {
+        WriteRaw(zeros, alignment - remainder);
+    }
+}
+
+void SnapshotWriter::BeginSection(SnapshotSection section) {
+    Align(SECTION_ALIGNMENT);
+    section_begin_ = offset_;
+    sections_.push_back({static_cast<uint32_t>(section), 0, offset_, 0});
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    WriteRaw(data, size);
+}
+
+void SnapshotWriter::EndSection() {
+    sections_.back().size = offset_ - section_begin_;
+}
+
+void SnapshotWriter::WriteStringTable(SnapshotSection offsets_section, SnapshotSection chars_section, const vector<string_view>& strings) {
+    vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    offsets.push_back(0);
+    for (const string_view str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    WriteSection(offsets_section, offsets.data(), offsets.size());
+
+    BeginSection(chars_section);
+    for (const string_view str : strings) {
+        Write(str.data(), str.size());
+    }
+    EndSection();
+}
+
+void SnapshotWriter::Finish() {
+    Align(alignof(SectionEntry));
+    const uint64_t table_offset = offset_;
+    WriteRaw(sections_.data(), sections_.size() * sizeof(SectionEntry));
+
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.section_count = static_cast<uint32_t>(sections_.size());
+    header.table_offset = table_offset;
+    header.file_size = offset_;
+    header.checksum = checksum_;
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Cannot write snapshot "s + temporary_path_);
+    }
+
+    // файл должен лечь на диск раньше, чем rename сделает его видимым под именем path
+    const int fd = open(temporary_path_.c_str(), O_WRONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw runtime_error("Cannot sync snapshot "s + temporary_path_);
+    }
+    close(fd);
+    if (rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        throw runtime_error("Cannot replace snapshot "s + path_);
+    }
+    finished_ = true;
+}
+
+SnapshotReader::SnapshotReader(const string& path, bool verify_checksum)
+    : file_(make_shared<const MappedFile>(path)) {
+    if (file_->size() < sizeof(SnapshotHeader)) {
+        throw runtime_error("Snapshot "s + path + " is truncated"s);
+    }
+    SnapshotHeader header;
+    memcpy(&header, file_->data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw runtime_error("File "s + path + " is not a search index snapshot"s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version "s + to_string(header.version));
+    }
+    if (header.file_size != file_->size() || header.table_offset > header.file_size) {
+        throw runtime_error("Snapshot "s + path + " is truncated"s);
+    }
+    if (verify_checksum) {
+        const uint64_t checksum = UpdateChecksum(FNV_OFFSET_BASIS, file_->data() + sizeof(header), file_->size() - sizeof(header));
+        if (checksum != header.checksum) {
+            throw runtime_error("Snapshot "s + path + " is corrupted"s);
+        }
+    }
+
+    struct SectionEntry {
+        uint32_t section;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+    if (header.table_offset + header.section_count * sizeof(SectionEntry) > header.file_size) {
+        throw runtime_error("Snapshot "s + path + " is truncated"s);
+    }
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        SectionEntry entry;
+        memcpy(&entry, file_->data() + header.table_offset + i * sizeof(SectionEntry), sizeof(entry));
+        // массивы секций читаются прямо из файла и должны быть выровнены
+        if (entry.offset % SECTION_ALIGNMENT != 0 || entry.offset > header.table_offset || entry.size > header.table_offset - entry.offset) {
+            throw runtime_error("Snapshot "s + path + " is corrupted"s);
+        }
+        sections_.emplace_back(static_cast<SnapshotSection>(entry.section), string_view(file_->data() + entry.offset, entry.size));
+    }
+}
+
+bool SnapshotReader::HasSection(SnapshotSection section) const {
+    for (const auto& [kind, _] : sections_) {
+        if (kind == section) {
+            return true;
+        }
+    }
+    return false;
+}
+
+string_view SnapshotReader::GetSection(SnapshotSection section) const {
+    for (const auto& [kind, bytes] : sections_) {
+        if (kind == section) {
+            return bytes;
+        }
+    }
+    throw runtime_error("Snapshot has no section "s + to_string(static_cast<uint32_t>(section)));
+}
+
+vector<string_view> SnapshotReader::GetStringTable(SnapshotSection offsets_section, SnapshotSection chars_section) const {
+    const auto offsets = GetArray<uint64_t>(offsets_section);
+    const string_view chars = GetSection(chars_section);
+    vector<string_view> strings;
+    if (offsets.empty()) {
+        return strings;
+    }
+    strings.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > chars.size()) {
+            throw runtime_error("Snapshot string table is corrupted"s);
+        }
+        strings.push_back(chars.substr(offsets[i], offsets[i + 1] - offsets[i]));
+    }
+    return strings;
+}
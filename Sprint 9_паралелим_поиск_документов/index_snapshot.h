@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_array.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Формат снимка: заголовок, секции, выровненные по 64 байта, и таблица секций в конце файла.
+// Контрольная сумма FNV-1a считается по всему, что идёт после заголовка.
+// Числа записываются в порядке байт машины, поэтому снимок переносим только
+// между машинами с одинаковым порядком байт
+const uint32_t SNAPSHOT_VERSION = 4;
+
+enum class SnapshotSection : uint32_t {
+    SETTINGS = 1,
+    STOP_WORD_OFFSETS,
+    STOP_WORD_CHARS,
+    TERM_OFFSETS,
+    TERM_CHARS,
+    TERM_DOCUMENT_COUNTS,
+    POSTING_DATA,
+    POSTING_DIRECTORY,
+    DOCUMENT_IDS,
+    DOCUMENT_STATUSES,
+    DOCUMENT_RATINGS,
+    DOCUMENT_INV_WORD_COUNTS,
+    DOCUMENT_TEXT_OFFSETS,
+    DOCUMENT_TEXT_LENGTHS,
+    DOCUMENT_TEXT_CHARS,
+    TEXT_CHUNK_SIZES,
+    TERM_MAX_FREQUENCIES,
+    FORWARD_OFFSETS,
+    FORWARD_TERMS,
+    LIVE_ORDINALS,
+};
+
+// Пишет снимок во временный файл рядом с path и подменяет им path только в Finish.
+// Снимок, открытый из path, продолжает читать прежний файл
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const string& path);
+
+    // Удаляет временный файл, если Finish не был вызван
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void BeginSection(SnapshotSection section);
+
+    void Write(const void* data, size_t size);
+
+    template <typename T>
+    void WriteArray(const T* data, size_t count) {
+        Write(data, count * sizeof(T));
+    }
+
+    // Дополняет файл нулями до кратного alignment смещения. Секции начинаются
+    // с границы 64 байт, поэтому выравнивание внутри секции сохраняется
+    void Align(size_t alignment);
+
+    // Смещение следующего байта от начала текущей секции
+    uint64_t GetSectionOffset() const {
+        return offset_ - section_begin_;
+    }
+
+    void EndSection();
+
+    template <typename T>
+    void WriteSection(SnapshotSection section, const T* data, size_t count) {
+        BeginSection(section);
+        WriteArray(data, count);
+        EndSection();
+    }
+
+    void WriteStringTable(SnapshotSection offsets_section, SnapshotSection chars_section, const vector<string_view>& strings);
+
+    void Finish();
+
+private:
+    struct SectionEntry {
+        uint32_t section;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    const string path_;
+    const string temporary_path_;
+    bool finished_ = false;
+    ofstream out_;
+    uint64_t offset_ = 0;
+    uint64_t section_begin_ = 0;
+    uint64_t checksum_;
+    vector<SectionEntry> sections_;
+
+    void WriteRaw(const void* data, size_t size);
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const string& path, bool verify_checksum);
+
+    bool HasSection(SnapshotSection section) const;
+
+    string_view GetSection(SnapshotSection section) const;
+
+    // Массив, который смотрит прямо в отображённый файл
+    template <typename T, typename Allocator = allocator<T>>
+    MappedArray<T, Allocator> GetArray(SnapshotSection section) const {
+        const string_view bytes = GetSection(section);
+        return MappedArray<T, Allocator>::View(reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T));
+    }
+
+    // Бросает runtime_error, если смещения строк выходят за таблицу символов
+    vector<string_view> GetStringTable(SnapshotSection offsets_section, SnapshotSection chars_section) const;
+
+    const shared_ptr<const MappedFile>& GetFile() const {
+        return file_;
+    }
+
+private:
+    shared_ptr<const MappedFile> file_;
+    vector<pair<SnapshotSection, string_view>> sections_;
+};
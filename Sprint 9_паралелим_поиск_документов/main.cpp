@@ -18,13 +18,14 @@ using namespace std::string_literals;
 using namespace std;
 
  
-void RunConcurrentUpdates(ConcurrentMap<int, int>& cm, size_t thread_count, int key_count) {
-    auto kernel = [&cm, key_count](int seed) {
+// key_count ключей от -key_count / 2; при малом key_count все потоки бьют в одни и те же ключи
+void RunConcurrentUpdates(ConcurrentMap<int, int>& cm, size_t thread_count, int key_count, int repeat_count = 2) {
+    auto kernel = [&cm, key_count, repeat_count](int seed) {
         vector<int> updates(key_count);
         iota(begin(updates), end(updates), -key_count / 2);
         shuffle(begin(updates), end(updates), mt19937(seed));
  
-        for (int i = 0; i < 2; ++i) {
+        for (int i = 0; i < repeat_count; ++i) {
             for (auto key : updates) {
                 ++cm[key].ref_to_value;
             }
@@ -37,36 +38,6 @@ void RunConcurrentUpdates(ConcurrentMap<int, int>& cm, size_t thread_count, int
     }
 }
 
-std::vector<std::vector<Document>> ProcessQueries(
-    const SearchServer& search_server,
-    const std::vector<std::string>& queries){
-    
-    std::vector<std::vector<Document>> v(queries.size());
-    
-    transform(execution::par,
-        queries.begin(), queries.end(),
-        v.begin(),
-        [&search_server](const string& str) { return search_server.FindTopDocuments(str); }
-    );
-    return v;
-} 
-
-vector<Document> ProcessQueriesJoined(
-    const SearchServer& search_server,
-    const std::vector<std::string>& queries){
-    
-    return transform_reduce(execution::par,
-        queries.begin(), queries.end(),
-        vector<Document>{},
-        [](vector<Document> T1, vector<Document> const& T2) {
-            T1.insert(T1.end(), T2.begin(), T2.end());
-            return T1;
-        },             
-        [&search_server](const string& str) { return search_server.FindTopDocuments(str); }
-    );
-    
-}
-
 void TestConcurrentUpdate() {
     constexpr size_t THREAD_COUNT = 3;
     constexpr size_t KEY_COUNT = 50000;
@@ -126,19 +97,26 @@ void TestSpeedup() {
         LOG_DURATION("100 locks");
         RunConcurrentUpdates(many_locks, 4, 50000);
     }
+    // сильная конкуренция: все потоки обновляют одни и те же 64 ключа
+    {
+        ConcurrentMap<int, int> many_locks(100);
+ 
+        LOG_DURATION("100 locks, 64 hot keys");
+        RunConcurrentUpdates(many_locks, 4, 64, 2000);
+    }
 }
-/*
-int main() {
+
+void TestConcurrentMaps() {
     TestRunner tr;
     RUN_TEST(tr, TestConcurrentUpdate);
     RUN_TEST(tr, TestReadAndWrite);
     RUN_TEST(tr, TestSpeedup);
 }
-*/
 
 
 #include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 #include <execution>
 #include <iostream>
 #include <string>
@@ -147,6 +125,10 @@ using namespace std;
 
 
 int main() {
+    // упавший тест завершает программу
+    TestConcurrentMaps();
+    TestSearchServer();
+
     SearchServer search_server("and with"s);
     int id = 0;
     for (
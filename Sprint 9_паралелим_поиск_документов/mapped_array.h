@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Массив, который либо владеет данными, либо смотрит в чужую память
+// (например, в отображённый файл снимка индекса). Чтение одинаково для обоих
+// случаев, а перед первым изменением данные копируются в собственный вектор
+template <typename T, typename Allocator = allocator<T>>
+class MappedArray {
+public:
+    MappedArray() = default;
+
+    MappedArray(size_t size, const T& value)
+        : owned_(size, value) {
+    }
+
+    static MappedArray View(const T* data, size_t size) {
+        MappedArray result;
+        result.view_ = data;
+        result.view_size_ = size;
+        result.is_view_ = true;
+        return result;
+    }
+
+    const T* data() const {
+        return is_view_ ? view_ : owned_.data();
+    }
+
+    size_t size() const {
+        return is_view_ ? view_size_ : owned_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    const T& front() const {
+        return data()[0];
+    }
+
+    const T& back() const {
+        return data()[size() - 1];
+    }
+
+    const T* begin() const {
+        return data();
+    }
+
+    const T* end() const {
+        return data() + size();
+    }
+
+    bool IsView() const {
+        return is_view_;
+    }
+
+    vector<T, Allocator>& Mutable() {
+        if (is_view_) {
+            owned_.assign(view_, view_ + view_size_);
+            view_ = nullptr;
+            view_size_ = 0;
+            is_view_ = false;
+        }
+        return owned_;
+    }
+
+private:
+    vector<T, Allocator> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+    bool is_view_ = false;
+};
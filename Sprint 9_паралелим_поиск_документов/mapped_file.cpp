@@ -0,0 +1,53 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error("Cannot stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Cannot map "s + path);
+        }
+        data_ = static_cast<const char*>(mapping);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+void MappedFile::PrefaultAsync(shared_ptr<const MappedFile> file) {
+    if (file->size_ == 0) {
+        return;
+    }
+    madvise(const_cast<char*>(file->data_), file->size_, MADV_WILLNEED);
+    thread([file] {
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        volatile char sink = 0;
+        for (size_t offset = 0; offset < file->size_; offset += page_size) {
+            sink = sink + file->data_[offset];
+        }
+    }).detach();
+}
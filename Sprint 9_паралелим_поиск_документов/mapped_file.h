@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// Файл, целиком отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    // Просит ядро подгрузить страницы и читает по байту с каждой в фоновом потоке.
+    // Поток держит shared_ptr на файл, поэтому отображение живёт, пока он не закончит
+    static void PrefaultAsync(shared_ptr<const MappedFile> file);
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
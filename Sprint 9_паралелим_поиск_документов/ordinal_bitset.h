@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Множество внутренних номеров документов, по биту на номер.
+// Запоминает диапазон изменённых слов, чтобы Clear не обнулял весь массив
+class OrdinalBitset {
+public:
+    // Расширяет множество до size номеров; уже установленные биты сохраняются
+    void Resize(size_t size) {
+        const size_t word_count = (size + 63) / 64;
+        if (words_.size() < word_count) {
+            words_.resize(word_count, 0);
+        }
+    }
+
+    void Set(uint32_t ordinal) {
+        const size_t word_index = ordinal >> 6;
+        words_[word_index] |= uint64_t{1} << (ordinal & 63);
+        first_dirty_word_ = min(first_dirty_word_, word_index);
+        last_dirty_word_ = max(last_dirty_word_, word_index + 1);
+    }
+
+    bool Test(uint32_t ordinal) const {
+        return (words_[ordinal >> 6] >> (ordinal & 63)) & 1;
+    }
+
+    // true, если ни один бит не установлен с последней очистки
+    bool IsClear() const {
+        return first_dirty_word_ >= last_dirty_word_;
+    }
+
+    void Clear() {
+        if (!IsClear()) {
+            fill(words_.begin() + first_dirty_word_, words_.begin() + last_dirty_word_, 0);
+        }
+        first_dirty_word_ = SIZE_MAX;
+        last_dirty_word_ = 0;
+    }
+
+private:
+    vector<uint64_t> words_;
+    size_t first_dirty_word_ = SIZE_MAX;
+    size_t last_dirty_word_ = 0;
+};
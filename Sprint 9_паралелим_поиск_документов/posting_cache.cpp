@@ -0,0 +1,234 @@
+#include "posting_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+const size_t SKETCH_ROW_COUNT = 4;
+const int SKETCH_WIDTH_BITS = 12;
+const size_t SKETCH_WIDTH = size_t{1} << SKETCH_WIDTH_BITS;
+// после стольких обращений все счётчики скетча уполовиниваются
+const uint32_t SKETCH_SAMPLE_SIZE = SKETCH_WIDTH * 10;
+const uint8_t SKETCH_COUNTER_LIMIT = 15;
+// набор попадает в кэш на таком по счёту обращении
+const uint8_t ADMISSION_COUNT = 3;
+
+const uint64_t SKETCH_SEEDS[SKETCH_ROW_COUNT] = {
+    0x9E3779B97F4A7C15ull,
+    0xC2B2AE3D27D4EB4Full,
+    0x165667B19E3779F9ull,
+    0xD6E8FEB86659FD93ull,
+};
+
+enum class SetKind : char {
+    PAIR,
+    UNION,
+};
+
+string MakeKey(SetKind kind, const vector<TermId>& terms) {
+    string key(1, static_cast<char>(kind));
+    key.append(reinterpret_cast<const char*>(terms.data()), terms.size() * sizeof(TermId));
+    return key;
+}
+
+size_t EstimateMemory(const string& key, const vector<TermId>& terms, const CachedPostings& postings) {
+    return sizeof(CachedPostings) + key.size() + terms.size() * (sizeof(TermId) + sizeof(uint32_t))
+           + (postings.ordinals.size() + postings.first_term_counts.size() + postings.second_term_counts.size()) * sizeof(uint32_t);
+}
+
+}  // namespace
+
+PostingCache::PostingCache(size_t memory_limit) {
+    SetMemoryLimit(memory_limit);
+}
+
+void PostingCache::SetMemoryLimit(size_t memory_limit) {
+    memory_limit_ = memory_limit;
+    storage_.reset();
+    if (memory_limit > 0) {
+        storage_ = make_unique<Storage>(SKETCH_ROW_COUNT * SKETCH_WIDTH);
+    }
+}
+
+bool PostingCache::RecordAccess(const string& key) const {
+    const uint64_t hash_value = hash<string>{}(key);
+    uint8_t estimate = SKETCH_COUNTER_LIMIT;
+    for (size_t row = 0; row < SKETCH_ROW_COUNT; ++row) {
+        atomic<uint8_t>& counter = storage_->sketch[row * SKETCH_WIDTH + ((hash_value * SKETCH_SEEDS[row]) >> (64 - SKETCH_WIDTH_BITS))];
+        // гонка может потерять приращение, для оценки частоты это неважно
+        uint8_t value = counter.load(memory_order_relaxed);
+        if (value < SKETCH_COUNTER_LIMIT) {
+            counter.store(++value, memory_order_relaxed);
+        }
+        estimate = min(estimate, value);
+    }
+    if (storage_->sketch_additions.fetch_add(1, memory_order_relaxed) + 1 == SKETCH_SAMPLE_SIZE) {
+        for (auto& counter : storage_->sketch) {
+            counter.store(counter.load(memory_order_relaxed) >> 1, memory_order_relaxed);
+        }
+        storage_->sketch_additions.store(0, memory_order_relaxed);
+    }
+    return estimate >= ADMISSION_COUNT;
+}
+
+bool PostingCache::IsFresh(const Entry& entry) const {
+    for (size_t i = 0; i < entry.terms.size(); ++i) {
+        if (term_versions_[entry.terms[i]] != entry.term_versions[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+shared_ptr<const CachedPostings> PostingCache::Find(const string& key) const {
+    Storage& storage = *storage_;
+    lock_guard<mutex> lock(storage.m);
+    const auto position = storage.positions.find(key);
+    if (position == storage.positions.end()) {
+        ++storage.misses;
+        return nullptr;
+    }
+    const auto entry = position->second;
+    if (!IsFresh(*entry)) {
+        storage.memory_used -= entry->memory;
+        storage.positions.erase(position);
+        storage.entries.erase(entry);
+        ++storage.misses;
+        return nullptr;
+    }
+    storage.entries.splice(storage.entries.begin(), storage.entries, entry);
+    ++storage.hits;
+    return entry->postings;
+}
+
+void PostingCache::Insert(string key, const vector<TermId>& terms, shared_ptr<const CachedPostings> postings) const {
+    const size_t memory = EstimateMemory(key, terms, *postings);
+    if (memory > memory_limit_) {
+        return;
+    }
+    vector<uint32_t> versions;
+    versions.reserve(terms.size());
+    for (const TermId term_id : terms) {
+        versions.push_back(term_versions_[term_id]);
+    }
+
+    Storage& storage = *storage_;
+    lock_guard<mutex> lock(storage.m);
+    // тот же набор успел построить другой поток
+    if (storage.positions.count(key) > 0) {
+        return;
+    }
+    while (storage.memory_used + memory > memory_limit_) {
+        storage.memory_used -= storage.entries.back().memory;
+        storage.positions.erase(storage.entries.back().key);
+        storage.entries.pop_back();
+    }
+    storage.entries.push_front({key, terms, move(versions), move(postings), memory});
+    storage.positions.emplace(move(key), storage.entries.begin());
+    storage.memory_used += memory;
+    ++storage.admissions;
+}
+
+shared_ptr<const CachedPostings> PostingCache::GetPair(const vector<PostingList>& posting_lists, TermId first, TermId second) const {
+    if (!storage_) {
+        return nullptr;
+    }
+    const vector<TermId> terms{first, second};
+    string key = MakeKey(SetKind::PAIR, terms);
+    if (auto postings = Find(key)) {
+        return postings;
+    }
+    // пара, которая не поместится в кэш, строилась бы заново при каждом запросе
+    if ((posting_lists[first].size() + posting_lists[second].size()) * 3 * sizeof(uint32_t) > memory_limit_ || !RecordAccess(key)) {
+        return nullptr;
+    }
+
+    vector<uint32_t> first_ordinals;
+    vector<uint32_t> first_counts;
+    first_ordinals.reserve(posting_lists[first].size());
+    first_counts.reserve(posting_lists[first].size());
+    posting_lists[first].ForEach([&](uint32_t ordinal, uint32_t term_count) {
+        first_ordinals.push_back(ordinal);
+        first_counts.push_back(term_count);
+    });
+
+    // слияние со вторым списком по возрастанию номеров
+    auto postings = make_shared<CachedPostings>();
+    const size_t bound = first_ordinals.size() + posting_lists[second].size();
+    postings->ordinals.reserve(bound);
+    postings->first_term_counts.reserve(bound);
+    postings->second_term_counts.reserve(bound);
+    const auto append = [&postings](uint32_t ordinal, uint32_t first_count, uint32_t second_count) {
+        postings->ordinals.push_back(ordinal);
+        postings->first_term_counts.push_back(first_count);
+        postings->second_term_counts.push_back(second_count);
+    };
+    size_t position = 0;
+    posting_lists[second].ForEach([&](uint32_t ordinal, uint32_t term_count) {
+        for (; position < first_ordinals.size() && first_ordinals[position] < ordinal; ++position) {
+            append(first_ordinals[position], first_counts[position], 0);
+        }
+        if (position < first_ordinals.size() && first_ordinals[position] == ordinal) {
+            append(ordinal, first_counts[position++], term_count);
+        } else {
+            append(ordinal, 0, term_count);
+        }
+    });
+    for (; position < first_ordinals.size(); ++position) {
+        append(first_ordinals[position], first_counts[position], 0);
+    }
+    postings->ordinals.shrink_to_fit();
+    postings->first_term_counts.shrink_to_fit();
+    postings->second_term_counts.shrink_to_fit();
+
+    Insert(move(key), terms, postings);
+    return postings;
+}
+
+shared_ptr<const CachedPostings> PostingCache::GetUnion(const vector<PostingList>& posting_lists, const vector<TermId>& minus_words) const {
+    if (!storage_) {
+        return nullptr;
+    }
+    string key = MakeKey(SetKind::UNION, minus_words);
+    if (auto postings = Find(key)) {
+        return postings;
+    }
+    size_t bound = 0;
+    for (const TermId term_id : minus_words) {
+        bound += posting_lists[term_id].size();
+    }
+    if (bound * sizeof(uint32_t) > memory_limit_ || !RecordAccess(key)) {
+        return nullptr;
+    }
+
+    auto postings = make_shared<CachedPostings>();
+    postings->ordinals.reserve(bound);
+    for (const TermId term_id : minus_words) {
+        posting_lists[term_id].ForEach([&postings](uint32_t ordinal, uint32_t) {
+            postings->ordinals.push_back(ordinal);
+        });
+    }
+    sort(postings->ordinals.begin(), postings->ordinals.end());
+    postings->ordinals.erase(unique(postings->ordinals.begin(), postings->ordinals.end()), postings->ordinals.end());
+    postings->ordinals.shrink_to_fit();
+
+    Insert(move(key), minus_words, postings);
+    return postings;
+}
+
+PostingCacheStats PostingCache::GetStats() const {
+    PostingCacheStats stats;
+    if (!storage_) {
+        return stats;
+    }
+    lock_guard<mutex> lock(storage_->m);
+    stats.hits = storage_->hits;
+    stats.misses = storage_->misses;
+    stats.admissions = storage_->admissions;
+    stats.size = storage_->entries.size();
+    stats.memory_used = storage_->memory_used;
+    return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+using namespace std;
+
+// Готовый к обходу список номеров для набора слов
+struct CachedPostings {
+    vector<uint32_t> ordinals;
+    // только у пары: сколько раз в документе встречается первое и второе слово, 0 — слова нет
+    vector<uint32_t> first_term_counts;
+    vector<uint32_t> second_term_counts;
+};
+
+struct PostingCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // сколько наборов прошло допуск и было построено
+    uint64_t admissions = 0;
+    size_t size = 0;
+    size_t memory_used = 0;
+};
+
+// Кэш объединённых списков вхождений для частых наборов слов: пар плюс-слов
+// запроса и наборов минус-слов. Набор попадает в кэш, когда оценка
+// его частоты по скетчу Count-Min достигает порога; скетч периодически
+// уполовинивается, чтобы старые обращения забывались (как в TinyLFU).
+// Объём ограничен в байтах, вытесняются давно не запрошенные наборы.
+// У каждого слова есть версия: AddDocument увеличивает версии слов документа,
+// и записи со старой версией хотя бы одного слова отбрасываются. Удаление документа
+// списков не меняет: его номер отсеивается при поиске, как и в самих списках
+class PostingCache {
+public:
+    // memory_limit == 0 — кэш выключен
+    explicit PostingCache(size_t memory_limit = 0);
+
+    // копия получает пустой кэш того же объёма
+    PostingCache(const PostingCache& other)
+        : PostingCache(other.memory_limit_) {
+        term_versions_ = other.term_versions_;
+    }
+
+    PostingCache& operator=(const PostingCache& other) {
+        SetMemoryLimit(other.memory_limit_);
+        term_versions_ = other.term_versions_;
+        return *this;
+    }
+
+    PostingCache(PostingCache&&) = default;
+    PostingCache& operator=(PostingCache&&) = default;
+
+    // Сбрасывает записи, скетч и счётчики
+    void SetMemoryLimit(size_t memory_limit);
+
+    bool IsEnabled() const {
+        return storage_ != nullptr;
+    }
+
+    void Resize(size_t term_count) {
+        if (term_versions_.size() < term_count) {
+            term_versions_.resize(term_count, 0);
+        }
+    }
+
+    // Разные слова можно отмечать из разных потоков
+    void InvalidateTerm(TermId term_id) {
+        if (term_id < term_versions_.size()) {
+            ++term_versions_[term_id];
+        }
+    }
+
+    // Объединение списков first < second или nullptr, если пара ещё не частая
+    shared_ptr<const CachedPostings> GetPair(const vector<PostingList>& posting_lists, TermId first, TermId second) const;
+
+    // Номера документов хотя бы с одним из minus_words или nullptr, если набор ещё не частый
+    shared_ptr<const CachedPostings> GetUnion(const vector<PostingList>& posting_lists, const vector<TermId>& minus_words) const;
+
+    PostingCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        string key;
+        vector<TermId> terms;
+        vector<uint32_t> term_versions;
+        shared_ptr<const CachedPostings> postings;
+        size_t memory;
+    };
+
+    struct Storage {
+        mutex m;
+        // в начале списка — последние запрошенные
+        list<Entry> entries;
+        unordered_map<string, list<Entry>::iterator> positions;
+        size_t memory_used = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t admissions = 0;
+        // скетч Count-Min: строки счётчиков, по одному хешу на строку
+        vector<atomic<uint8_t>> sketch;
+        atomic<uint32_t> sketch_additions{0};
+
+        explicit Storage(size_t sketch_size)
+            : sketch(sketch_size) {
+        }
+    };
+
+    size_t memory_limit_ = 0;
+    unique_ptr<Storage> storage_;
+    vector<uint32_t> term_versions_;
+
+    // Учитывает обращение к набору; true, если набор достаточно частый для кэша
+    bool RecordAccess(const string& key) const;
+
+    shared_ptr<const CachedPostings> Find(const string& key) const;
+
+    void Insert(string key, const vector<TermId>& terms, shared_ptr<const CachedPostings> postings) const;
+
+    bool IsFresh(const Entry& entry) const;
+};
@@ -0,0 +1,95 @@
+#include "posting_codec.h"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+uint8_t GetByteLength(uint32_t value) {
+    if (value < (1u << 8)) {
+        return 1;
+    }
+    if (value < (1u << 16)) {
+        return 2;
+    }
+    if (value < (1u << 24)) {
+        return 3;
+    }
+    return 4;
+}
+
+#ifdef __SSSE3__
+struct ShuffleTables {
+    uint8_t masks[256][16];
+    uint8_t lengths[256];
+};
+
+constexpr ShuffleTables MakeShuffleTables() {
+    ShuffleTables tables{};
+    for (int control = 0; control < 256; ++control) {
+        uint8_t offset = 0;
+        for (int value = 0; value < 4; ++value) {
+            const uint8_t length = ((control >> (2 * value)) & 3) + 1;
+            for (int byte = 0; byte < 4; ++byte) {
+                tables.masks[control][value * 4 + byte] = byte < length ? offset + byte : 0x80;
+            }
+            offset += length;
+        }
+        tables.lengths[control] = offset;
+    }
+    return tables;
+}
+
+constexpr ShuffleTables SHUFFLE_TABLES = MakeShuffleTables();
+#endif
+
+}  // namespace
+
+void EncodeStreamVByte(const uint32_t* values, size_t count, vector<uint8_t>& out) {
+    const size_t control_begin = out.size();
+    const size_t control_size = (count + 3) / 4;
+    out.resize(control_begin + control_size, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t length = GetByteLength(values[i]);
+        out[control_begin + i / 4] |= (length - 1) << (2 * (i % 4));
+        for (uint8_t byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+size_t GetStreamVByteSize(const uint8_t* in, size_t count) {
+    size_t size = (count + 3) / 4;
+    for (size_t i = 0; i < count; ++i) {
+        size += ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    }
+    return size;
+}
+
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* out) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    size_t i = 0;
+#ifdef __SSSE3__
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t code = control[i / 4];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHUFFLE_TABLES.masks[code]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(bytes, mask));
+        data += SHUFFLE_TABLES.lengths[code];
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint8_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (uint8_t byte = 0; byte < length; ++byte) {
+            value |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        out[i] = value;
+        data += length;
+    }
+    return data;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Сколько байт можно прочитать за концом закодированных данных:
+// SIMD-декодер всегда загружает по 16 байт
+const size_t STREAM_VBYTE_PADDING = 16;
+
+// Кодирует count чисел в формате StreamVByte: сначала управляющие байты
+// (по 2 бита длины на число), затем сами числа длиной от 1 до 4 байт
+void EncodeStreamVByte(const uint32_t* values, size_t count, vector<uint8_t>& out);
+
+// Длина потока из count чисел, посчитанная по его управляющим байтам
+size_t GetStreamVByteSize(const uint8_t* in, size_t count);
+
+// Декодирует count чисел и возвращает указатель на байт, следующий за потоком.
+// При сборке с SSSE3 четвёрки чисел распаковываются одной перестановкой байт
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* out);
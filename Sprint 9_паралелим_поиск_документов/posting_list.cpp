@@ -0,0 +1,367 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t PostingList::GetLastOrdinal() const {
+    return ordinals_.empty() ? blocks_.back().last_ordinal : ordinals_.back();
+}
+
+size_t PostingList::FindTailPosition(uint32_t ordinal) const {
+    return lower_bound(ordinals_.begin(), ordinals_.end(), ordinal) - ordinals_.begin();
+}
+
+size_t PostingList::FindBlock(uint32_t ordinal) const {
+    return lower_bound(blocks_.begin(), blocks_.end(), ordinal, [](const BlockHeader& block, uint32_t value) {
+        return block.last_ordinal < value;
+    }) - blocks_.begin();
+}
+
+void PostingList::AddToBlockMax(uint32_t ordinal, double term_frequency) {
+    auto& block_maxima = block_maxima_.Mutable();
+    auto it = lower_bound(block_maxima.begin(), block_maxima.end(), ordinal, [](const BlockMax& block, uint32_t value) {
+        return block.last_ordinal < value;
+    });
+    if (it == block_maxima.end()) {
+        if (block_maxima.empty() || block_maxima.back().count == POSTING_BLOCK_SIZE) {
+            block_maxima.push_back({ordinal, 1, term_frequency});
+            return;
+        }
+        it = prev(block_maxima.end());
+        it->last_ordinal = ordinal;
+    }
+    // вставка в середину может переполнить диапазон: это редкость, и оценка остаётся верной
+    ++it->count;
+    it->max_frequency = max(it->max_frequency, term_frequency);
+}
+
+void PostingList::Insert(uint32_t ordinal, uint32_t term_count, double term_frequency) {
+    EnsureChecked();
+    if (empty() || GetLastOrdinal() < ordinal) {
+        AddToBlockMax(ordinal, term_frequency);
+        ordinals_.Mutable().push_back(ordinal);
+        term_counts_.Mutable().push_back(term_count);
+        ++size_;
+        if (compressed_ && ordinals_.size() == POSTING_BLOCK_SIZE) {
+            AppendBlock(ordinals_.data(), term_counts_.data(), ordinals_.size());
+            ordinals_.Mutable().clear();
+            term_counts_.Mutable().clear();
+        }
+        return;
+    }
+    if (compressed_) {
+        // номера документов растут, поэтому вставка в середину сжатого списка
+        // редкость, и список проще перепаковать целиком
+        Decompress();
+        Insert(ordinal, term_count, term_frequency);
+        Compress();
+        return;
+    }
+    const size_t position = FindTailPosition(ordinal);
+    if (position < ordinals_.size() && ordinals_[position] == ordinal) {
+        // TF растёт вместе с числом вхождений: длина документа та же
+        const uint32_t total_count = term_counts_[position] + term_count;
+        term_counts_.Mutable()[position] = total_count;
+        auto& block_maxima = block_maxima_.Mutable();
+        const auto it = lower_bound(block_maxima.begin(), block_maxima.end(), ordinal, [](const BlockMax& block, uint32_t value) {
+            return block.last_ordinal < value;
+        });
+        it->max_frequency = max(it->max_frequency, term_frequency / term_count * total_count);
+        return;
+    }
+    AddToBlockMax(ordinal, term_frequency);
+    auto& ordinals = ordinals_.Mutable();
+    auto& term_counts = term_counts_.Mutable();
+    ordinals.insert(ordinals.begin() + position, ordinal);
+    term_counts.insert(term_counts.begin() + position, term_count);
+    ++size_;
+}
+
+bool PostingList::Contains(uint32_t ordinal) const {
+    EnsureChecked();
+    if (!ordinals_.empty() && ordinal >= ordinals_.front()) {
+        const size_t position = FindTailPosition(ordinal);
+        return position < ordinals_.size() && ordinals_[position] == ordinal;
+    }
+
+    const size_t block_index = FindBlock(ordinal);
+    if (block_index == blocks_.size() || blocks_[block_index].first_ordinal > ordinal) {
+        return false;
+    }
+    uint32_t ordinals[POSTING_BLOCK_SIZE];
+    uint32_t term_counts[POSTING_BLOCK_SIZE];
+    const size_t count = DecodeBlock(block_index, ordinals, term_counts);
+    return binary_search(ordinals, ordinals + count, ordinal);
+}
+
+void PostingList::Compress() {
+    if (compressed_) {
+        return;
+    }
+    EnsureChecked();
+    compressed_ = true;
+    const size_t encoded_count = ordinals_.size() / POSTING_BLOCK_SIZE * POSTING_BLOCK_SIZE;
+    for (size_t begin = 0; begin < encoded_count; begin += POSTING_BLOCK_SIZE) {
+        AppendBlock(ordinals_.data() + begin, term_counts_.data() + begin, POSTING_BLOCK_SIZE);
+    }
+    auto& ordinals = ordinals_.Mutable();
+    auto& term_counts = term_counts_.Mutable();
+    ordinals.erase(ordinals.begin(), ordinals.begin() + encoded_count);
+    term_counts.erase(term_counts.begin(), term_counts.begin() + encoded_count);
+    ordinals.shrink_to_fit();
+    term_counts.shrink_to_fit();
+}
+
+void PostingList::Decompress() {
+    if (!compressed_) {
+        return;
+    }
+    vector<uint32_t> ordinals;
+    vector<uint32_t> term_counts;
+    ordinals.reserve(size_);
+    term_counts.reserve(size_);
+    ForEach([&](uint32_t ordinal, uint32_t term_count) {
+        ordinals.push_back(ordinal);
+        term_counts.push_back(term_count);
+    });
+    ordinals_.Mutable() = move(ordinals);
+    term_counts_.Mutable() = move(term_counts);
+    blocks_ = MappedArray<BlockHeader>();
+    encoded_ = MappedArray<uint8_t>();
+    compressed_ = false;
+}
+
+size_t PostingList::DecodeBlock(size_t block_index, uint32_t* ordinals, uint32_t* term_counts) const {
+    const BlockHeader& block = blocks_[block_index];
+    const uint8_t* data = DecodeStreamVByte(encoded_.data() + block.offset, block.count, ordinals);
+    uint32_t ordinal = block.first_ordinal;
+    for (size_t i = 0; i < block.count; ++i) {
+        ordinal += ordinals[i];
+        ordinals[i] = ordinal;
+    }
+    DecodeStreamVByte(data, block.count, term_counts);
+    return block.count;
+}
+
+vector<uint8_t> PostingList::EncodeBlock(const uint32_t* ordinals, const uint32_t* term_counts, size_t count) const {
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+    deltas[0] = 0;
+    for (size_t i = 1; i < count; ++i) {
+        deltas[i] = ordinals[i] - ordinals[i - 1];
+    }
+    vector<uint8_t> bytes;
+    bytes.reserve(count * 3);
+    EncodeStreamVByte(deltas, count, bytes);
+    EncodeStreamVByte(term_counts, count, bytes);
+    return bytes;
+}
+
+void PostingList::AppendBlock(const uint32_t* ordinals, const uint32_t* term_counts, size_t count) {
+    const vector<uint8_t> bytes = EncodeBlock(ordinals, term_counts, count);
+    auto& encoded = encoded_.Mutable();
+    const size_t data_end = encoded.empty() ? 0 : encoded.size() - STREAM_VBYTE_PADDING;
+    encoded.resize(data_end);
+    blocks_.Mutable().push_back({ordinals[0], ordinals[count - 1], static_cast<uint32_t>(data_end), static_cast<uint32_t>(count)});
+    encoded.insert(encoded.end(), bytes.begin(), bytes.end());
+    encoded.resize(encoded.size() + STREAM_VBYTE_PADDING, 0);
+}
+
+void PostingList::RunPendingCheck() const {
+    uint8_t state = pending_check_.state.load(memory_order_acquire);
+    if (state == PendingCheck::PENDING) {
+        state = IsValid(pending_check_.document_count) ? PendingCheck::CHECKED : PendingCheck::CORRUPTED;
+        pending_check_.state.store(state, memory_order_release);
+    }
+    if (state == PendingCheck::CORRUPTED) {
+        throw runtime_error("Snapshot postings are corrupted"s);
+    }
+}
+
+void PostingList::Cursor::LoadSegment(size_t segment) {
+    segment_ = segment;
+    position_ = 0;
+    if (segment < postings_->blocks_.size()) {
+        count_ = postings_->DecodeBlock(segment, ordinal_buffer_, term_count_buffer_);
+        buffered_ = true;
+    } else if (segment == postings_->blocks_.size()) {
+        count_ = postings_->ordinals_.size();
+        buffered_ = false;
+    } else {
+        count_ = 0;
+    }
+    if (count_ == 0) {
+        segment_ = postings_->blocks_.size() + 1;
+        ordinal_ = END;
+        return;
+    }
+    ordinal_ = GetOrdinals()[0];
+}
+
+void PostingList::Cursor::NextGEQ(uint32_t target) {
+    if (ordinal_ >= target) {
+        return;
+    }
+    const auto& blocks = postings_->blocks_;
+    if (segment_ < blocks.size() && blocks[segment_].last_ordinal < target) {
+        // блоки, целиком лежащие до target, не распаковываются
+        const size_t block_index = lower_bound(blocks.begin() + segment_ + 1, blocks.end(), target, [](const BlockHeader& block, uint32_t value) {
+            return block.last_ordinal < value;
+        }) - blocks.begin();
+        LoadSegment(block_index);
+        if (ordinal_ >= target) {
+            return;
+        }
+    }
+    const uint32_t* ordinals = GetOrdinals();
+    position_ = lower_bound(ordinals + position_, ordinals + count_, target) - ordinals;
+    if (position_ < count_) {
+        ordinal_ = ordinals[position_];
+    } else {
+        LoadSegment(segment_ + 1);
+    }
+}
+
+namespace {
+
+struct PostingDirectoryEntry {
+    uint64_t ordinals_offset;
+    uint64_t term_counts_offset;
+    uint64_t blocks_offset;
+    uint64_t encoded_offset;
+    uint64_t block_maxima_offset;
+    uint32_t tail_size;
+    uint32_t block_count;
+    uint32_t encoded_size;
+    uint32_t size;
+    uint32_t compressed;
+    uint32_t block_max_count;
+};
+
+// Массив из count элементов секции, начиная со смещения offset
+template <typename T>
+MappedArray<T> ViewPostingData(string_view data, uint64_t offset, size_t count) {
+    if (offset > data.size() || count > (data.size() - offset) / sizeof(T)
+        || reinterpret_cast<uintptr_t>(data.data() + offset) % alignof(T) != 0) {
+        throw runtime_error("Snapshot postings are corrupted"s);
+    }
+    return MappedArray<T>::View(reinterpret_cast<const T*>(data.data() + offset), count);
+}
+
+}  // namespace
+
+bool PostingList::IsValid(size_t document_count) const {
+    size_t count = ordinals_.size();
+    uint32_t last_ordinal = 0;
+    for (const uint32_t ordinal : ordinals_) {
+        if (ordinal >= document_count) {
+            return false;
+        }
+        last_ordinal = max(last_ordinal, ordinal);
+    }
+
+    const size_t data_end = blocks_.empty() ? 0 : encoded_.size() - STREAM_VBYTE_PADDING;
+    uint32_t ordinals[POSTING_BLOCK_SIZE];
+    uint32_t term_counts[POSTING_BLOCK_SIZE];
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        const BlockHeader& block = blocks_[i];
+        const size_t block_end = i + 1 < blocks_.size() ? blocks_[i + 1].offset : data_end;
+        if (block.count == 0 || block.count > POSTING_BLOCK_SIZE || block.offset > block_end || block_end > data_end) {
+            return false;
+        }
+        // номера и частоты: у каждого потока сначала управляющие байты, по ним считается его длина
+        const size_t control_size = (block.count + 3) / 4;
+        size_t stream_begin = block.offset;
+        for (int stream = 0; stream < 2; ++stream) {
+            if (block_end - stream_begin < control_size) {
+                return false;
+            }
+            const size_t stream_size = GetStreamVByteSize(encoded_.data() + stream_begin, block.count);
+            if (stream_size > block_end - stream_begin) {
+                return false;
+            }
+            stream_begin += stream_size;
+        }
+        // переполнение суммы разностей нарушило бы порядок номеров
+        DecodeBlock(i, ordinals, term_counts);
+        if (ordinals[0] != block.first_ordinal || ordinals[block.count - 1] != block.last_ordinal || block.last_ordinal >= document_count
+            || !is_sorted(ordinals, ordinals + block.count)) {
+            return false;
+        }
+        last_ordinal = max(last_ordinal, block.last_ordinal);
+        count += block.count;
+    }
+    if (count != size_) {
+        return false;
+    }
+    // диапазоны оценок должны покрывать все номера списка
+    return size_ == 0 || (!block_maxima_.empty() && block_maxima_.back().last_ordinal >= last_ordinal);
+}
+
+void PostingList::SaveAll(const vector<PostingList>& posting_lists, SnapshotWriter& writer) {
+    vector<PostingDirectoryEntry> directory;
+    directory.reserve(posting_lists.size());
+
+    writer.BeginSection(SnapshotSection::POSTING_DATA);
+    for (const PostingList& postings : posting_lists) {
+        // испорченный список не переносится в новый снимок
+        postings.EnsureChecked();
+        PostingDirectoryEntry entry{};
+        entry.tail_size = static_cast<uint32_t>(postings.ordinals_.size());
+        entry.block_count = static_cast<uint32_t>(postings.blocks_.size());
+        entry.encoded_size = static_cast<uint32_t>(postings.encoded_.size());
+        entry.size = static_cast<uint32_t>(postings.size_);
+        entry.compressed = postings.compressed_;
+        entry.block_max_count = static_cast<uint32_t>(postings.block_maxima_.size());
+
+        writer.Align(sizeof(uint32_t));
+        entry.ordinals_offset = writer.GetSectionOffset();
+        writer.WriteArray(postings.ordinals_.data(), postings.ordinals_.size());
+        entry.term_counts_offset = writer.GetSectionOffset();
+        writer.WriteArray(postings.term_counts_.data(), postings.term_counts_.size());
+        entry.blocks_offset = writer.GetSectionOffset();
+        writer.WriteArray(postings.blocks_.data(), postings.blocks_.size());
+        entry.encoded_offset = writer.GetSectionOffset();
+        writer.WriteArray(postings.encoded_.data(), postings.encoded_.size());
+        writer.Align(alignof(BlockMax));
+        entry.block_maxima_offset = writer.GetSectionOffset();
+        writer.WriteArray(postings.block_maxima_.data(), postings.block_maxima_.size());
+        directory.push_back(entry);
+    }
+    writer.EndSection();
+
+    writer.WriteSection(SnapshotSection::POSTING_DIRECTORY, directory.data(), directory.size());
+}
+
+vector<PostingList> PostingList::LoadAll(const SnapshotReader& reader, size_t document_count, bool checksum_verified) {
+    const string_view data = reader.GetSection(SnapshotSection::POSTING_DATA);
+    const auto directory = reader.GetArray<PostingDirectoryEntry>(SnapshotSection::POSTING_DIRECTORY);
+
+    vector<PostingList> posting_lists(directory.size());
+    for (size_t i = 0; i < directory.size(); ++i) {
+        const PostingDirectoryEntry& entry = directory[i];
+        // за данными последнего блока идут STREAM_VBYTE_PADDING байт, которые читает SIMD-декодер
+        if ((entry.compressed == 0 && entry.block_count != 0) || (entry.block_count != 0 && entry.encoded_size < STREAM_VBYTE_PADDING)) {
+            throw runtime_error("Snapshot postings are corrupted"s);
+        }
+        PostingList& postings = posting_lists[i];
+        postings.ordinals_ = ViewPostingData<uint32_t>(data, entry.ordinals_offset, entry.tail_size);
+        postings.term_counts_ = ViewPostingData<uint32_t>(data, entry.term_counts_offset, entry.tail_size);
+        postings.blocks_ = ViewPostingData<BlockHeader>(data, entry.blocks_offset, entry.block_count);
+        postings.encoded_ = ViewPostingData<uint8_t>(data, entry.encoded_offset, entry.encoded_size);
+        postings.block_maxima_ = ViewPostingData<BlockMax>(data, entry.block_maxima_offset, entry.block_max_count);
+        postings.size_ = entry.size;
+        postings.compressed_ = entry.compressed != 0;
+        // проверка читала бы все страницы списков, а снимок и открывается отображением, чтобы их не читать
+        if (!checksum_verified) {
+            postings.pending_check_.document_count = document_count;
+            postings.pending_check_.state.store(PendingCheck::PENDING, memory_order_relaxed);
+        }
+    }
+    return posting_lists;
+}
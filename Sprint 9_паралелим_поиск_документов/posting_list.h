@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "mapped_array.h"
+
+using namespace std;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+const size_t POSTING_BLOCK_SIZE = 128;
+
+// Вхождения одного слова, отсортированные по номеру документа.
+// В обычном режиме номера и частоты лежат двумя плоскими массивами.
+// В сжатом режиме полные блоки по POSTING_BLOCK_SIZE вхождений хранятся
+// как разности номеров и частоты в формате StreamVByte, а в плоских
+// массивах остаётся только хвост, ещё не набравший блок.
+// Независимо от сжатия список поделён на диапазоны номеров примерно по
+// POSTING_BLOCK_SIZE вхождений, и для каждого диапазона хранится наибольшая TF:
+// по ней поиск пропускает диапазоны, которые не могут попасть в лучшие
+class PostingList {
+public:
+    // term_frequency — TF слова в документе, из неё строится оценка диапазона
+    void Insert(uint32_t ordinal, uint32_t term_count, double term_frequency);
+
+    bool Contains(uint32_t ordinal) const;
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    bool IsCompressed() const {
+        return compressed_;
+    }
+
+    void Compress();
+
+    void Decompress();
+
+    // Вызывает function(ordinals, term_counts, count) для каждого блока вхождений по порядку
+    template <typename Function>
+    void ForEachBlock(Function function) const;
+
+    // То же для вхождений с номерами из [begin, end); сжатые блоки вне диапазона не распаковываются
+    template <typename Function>
+    void ForEachBlockInRange(uint32_t begin, uint32_t end, Function function) const;
+
+    // Вызывает function(ordinal, term_count) для каждого вхождения по порядку
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    // Курсор для обхода по документам: двигается вперёд и умеет перескакивать
+    // к первому номеру не меньше заданного, пропуская сжатые блоки целиком
+    class Cursor;
+
+    static void SaveAll(const vector<PostingList>& posting_lists, SnapshotWriter& writer);
+
+    // Списки читают блоки прямо из отображённого файла и копируют их только при изменении.
+    // Бросает runtime_error, если смещения или длины выходят за границы. Блоки и номера документов
+    // сверяются с границами, только если контрольная сумма файла не проверена, и не сразу,
+    // а при первом обращении к списку: испорченный список бросает runtime_error оттуда
+    static vector<PostingList> LoadAll(const SnapshotReader& reader, size_t document_count, bool checksum_verified);
+
+private:
+    struct BlockHeader {
+        uint32_t first_ordinal;
+        uint32_t last_ordinal;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Диапазон номеров (last_ordinal предыдущего диапазона, last_ordinal].
+    // После удаления вхождений max_frequency может остаться завышенной
+    struct BlockMax {
+        uint32_t last_ordinal;
+        uint32_t count;
+        double max_frequency;
+    };
+
+    // Проверка списка из снимка, отложенная до первого обращения. Два потока могут
+    // проверить список одновременно: оба получат один ответ
+    struct PendingCheck {
+        enum State : uint8_t {
+            CHECKED,
+            PENDING,
+            CORRUPTED,
+        };
+
+        atomic<uint8_t> state{CHECKED};
+        size_t document_count = 0;
+
+        PendingCheck() = default;
+
+        PendingCheck(const PendingCheck& other) noexcept
+            : state(other.state.load(memory_order_acquire))
+            , document_count(other.document_count) {
+        }
+
+        PendingCheck& operator=(const PendingCheck& other) noexcept {
+            state.store(other.state.load(memory_order_acquire), memory_order_release);
+            document_count = other.document_count;
+            return *this;
+        }
+    };
+
+    MappedArray<uint32_t> ordinals_;
+    MappedArray<uint32_t> term_counts_;
+    MappedArray<BlockHeader> blocks_;
+    MappedArray<uint8_t> encoded_;
+    MappedArray<BlockMax> block_maxima_;
+    size_t size_ = 0;
+    bool compressed_ = false;
+    mutable PendingCheck pending_check_;
+
+    uint32_t GetLastOrdinal() const;
+
+    size_t FindTailPosition(uint32_t ordinal) const;
+
+    size_t FindBlock(uint32_t ordinal) const;
+
+    void AddToBlockMax(uint32_t ordinal, double term_frequency);
+
+    size_t DecodeBlock(size_t block_index, uint32_t* ordinals, uint32_t* term_counts) const;
+
+    vector<uint8_t> EncodeBlock(const uint32_t* ordinals, const uint32_t* term_counts, size_t count) const;
+
+    void AppendBlock(const uint32_t* ordinals, const uint32_t* term_counts, size_t count);
+
+    // Всё, по чему обход адресует память, лежит в своих массивах, а номера документов меньше document_count
+    bool IsValid(size_t document_count) const;
+
+    // Бросает runtime_error, если список из снимка испорчен. Вызывается перед любым чтением блоков
+    void EnsureChecked() const {
+        if (pending_check_.state.load(memory_order_acquire) != PendingCheck::CHECKED) {
+            RunPendingCheck();
+        }
+    }
+
+    void RunPendingCheck() const;
+};
+
+class PostingList::Cursor {
+public:
+    // номер документа у курсора, дошедшего до конца списка
+    static const uint32_t END = UINT32_MAX;
+
+    explicit Cursor(const PostingList& postings)
+        : postings_(&postings) {
+        postings.EnsureChecked();
+        LoadSegment(0);
+    }
+
+    uint32_t GetOrdinal() const {
+        return ordinal_;
+    }
+
+    uint32_t GetTermCount() const {
+        return GetTermCounts()[position_];
+    }
+
+    void Next() {
+        if (++position_ < count_) {
+            ordinal_ = GetOrdinals()[position_];
+        } else {
+            LoadSegment(segment_ + 1);
+        }
+    }
+
+    // Переходит к первому вхождению с номером не меньше target
+    void NextGEQ(uint32_t target);
+
+    // Находит диапазон, в который попадает номер target, не распаковывая блоков.
+    // target не должен убывать от вызова к вызову
+    void ShallowNextGEQ(uint32_t target) {
+        const auto& block_maxima = postings_->block_maxima_;
+        while (block_max_index_ < block_maxima.size() && block_maxima[block_max_index_].last_ordinal < target) {
+            ++block_max_index_;
+        }
+    }
+
+    // Наибольшая TF в диапазоне, найденном ShallowNextGEQ; 0, если список кончился
+    double GetBlockMaxFrequency() const {
+        const auto& block_maxima = postings_->block_maxima_;
+        return block_max_index_ < block_maxima.size() ? block_maxima[block_max_index_].max_frequency : 0.0;
+    }
+
+    // Последний номер диапазона, найденного ShallowNextGEQ
+    uint32_t GetBlockLastOrdinal() const {
+        const auto& block_maxima = postings_->block_maxima_;
+        return block_max_index_ < block_maxima.size() ? block_maxima[block_max_index_].last_ordinal : END;
+    }
+
+private:
+    const PostingList* postings_;
+    // номер сжатого блока; номер, равный числу блоков, означает несжатый хвост
+    size_t segment_ = 0;
+    size_t position_ = 0;
+    size_t count_ = 0;
+    size_t block_max_index_ = 0;
+    uint32_t ordinal_ = END;
+    bool buffered_ = false;
+    uint32_t ordinal_buffer_[POSTING_BLOCK_SIZE];
+    uint32_t term_count_buffer_[POSTING_BLOCK_SIZE];
+
+    const uint32_t* GetOrdinals() const {
+        return buffered_ ? ordinal_buffer_ : postings_->ordinals_.data();
+    }
+
+    const uint32_t* GetTermCounts() const {
+        return buffered_ ? term_count_buffer_ : postings_->term_counts_.data();
+    }
+
+    void LoadSegment(size_t segment);
+};
+
+template <typename Function>
+void PostingList::ForEachBlock(Function function) const {
+    ForEachBlockInRange(0, Cursor::END, function);
+}
+
+template <typename Function>
+void PostingList::ForEachBlockInRange(uint32_t begin, uint32_t end, Function function) const {
+    if (begin >= end) {
+        return;
+    }
+    EnsureChecked();
+    if (compressed_) {
+        uint32_t ordinals[POSTING_BLOCK_SIZE];
+        uint32_t term_counts[POSTING_BLOCK_SIZE];
+        const auto first_block = partition_point(blocks_.begin(), blocks_.end(), [begin](const BlockHeader& block) {
+            return block.last_ordinal < begin;
+        });
+        for (size_t i = first_block - blocks_.begin(); i < blocks_.size() && blocks_[i].first_ordinal < end; ++i) {
+            const size_t count = DecodeBlock(i, ordinals, term_counts);
+            const size_t first = lower_bound(ordinals, ordinals + count, begin) - ordinals;
+            const size_t last = lower_bound(ordinals + first, ordinals + count, end) - ordinals;
+            function(static_cast<const uint32_t*>(ordinals + first), static_cast<const uint32_t*>(term_counts + first), last - first);
+        }
+    }
+    const size_t first = lower_bound(ordinals_.begin(), ordinals_.end(), begin) - ordinals_.begin();
+    const size_t last = lower_bound(ordinals_.begin() + first, ordinals_.end(), end) - ordinals_.begin();
+    for (size_t position = first; position < last; position += POSTING_BLOCK_SIZE) {
+        function(ordinals_.data() + position, term_counts_.data() + position, min(POSTING_BLOCK_SIZE, last - position));
+    }
+}
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    ForEachBlock([&function](const uint32_t* ordinals, const uint32_t* term_counts, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            function(ordinals[i], term_counts[i]);
+        }
+    });
+}
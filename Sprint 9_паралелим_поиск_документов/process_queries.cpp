@@ -0,0 +1,66 @@
+#include "process_queries.h"
+
+#include <algorithm>
+#include <execution>
+#include <memory>
+#include <numeric>
+
+using namespace std;
+
+vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<string>& queries) {
+    vector<vector<Document>> v(queries.size());
+    transform(execution::par,
+        queries.begin(), queries.end(),
+        v.begin(),
+        [&search_server](const string& str) { return search_server.FindTopDocuments(str); }
+    );
+    return v;
+}
+
+vector<vector<Document>> ProcessQueries(const ThreadPoolPolicy& policy, const SearchServer& search_server, const vector<string>& queries) {
+    vector<vector<Document>> v(queries.size());
+    policy.GetPool().ParallelFor(queries.size(), [&](size_t i) {
+        v[i] = search_server.FindTopDocuments(queries[i]);
+    });
+    return v;
+}
+
+vector<vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const vector<string>& queries) {
+    return search_server.FindTopDocumentsBatch(execution::par, queries);
+}
+
+vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries) {
+    return transform_reduce(execution::par,
+        queries.begin(), queries.end(),
+        vector<Document>{},
+        [](vector<Document> T1, vector<Document> const& T2) {
+            T1.insert(T1.end(), T2.begin(), T2.end());
+            return T1;
+        },
+        [&search_server](const string& str) { return search_server.FindTopDocuments(str); }
+    );
+}
+
+vector<Document> ProcessQueriesJoined(const ThreadPoolPolicy& policy, const SearchServer& search_server, const vector<string>& queries) {
+    vector<Document> joined;
+    for (auto& documents : ProcessQueries(policy, search_server, queries)) {
+        joined.insert(joined.end(), documents.begin(), documents.end());
+    }
+    return joined;
+}
+
+future<vector<vector<Document>>> ProcessQueriesAsync(ThreadPool& pool, const SearchServer& search_server, vector<string> queries, const QueryOptions& options) {
+    auto task = make_shared<packaged_task<vector<vector<Document>>()>>([&pool, &search_server, queries = move(queries), options] {
+        vector<vector<Document>> v(queries.size());
+        pool.ParallelFor(queries.size(), [&](size_t i) {
+            options.cancellation.ThrowIfCancelled();
+            v[i] = search_server.FindTopDocuments(queries[i], DocumentStatus::ACTUAL, options);
+        });
+        return v;
+    });
+    future<vector<vector<Document>>> result = task->get_future();
+    pool.Submit([task] {
+        (*task)();
+    });
+    return result;
+}
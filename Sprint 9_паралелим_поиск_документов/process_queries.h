@@ -0,0 +1,27 @@
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+#include "search_server.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Результаты запросов в порядке запросов; запросы выполняются параллельно
+vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<string>& queries);
+
+vector<vector<Document>> ProcessQueries(const ThreadPoolPolicy& policy, const SearchServer& search_server, const vector<string>& queries);
+
+// Пакетный вариант: список вхождений каждого слова читается один раз на все запросы
+vector<vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const vector<string>& queries);
+
+// Результаты всех запросов одним списком
+vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries);
+
+vector<Document> ProcessQueriesJoined(const ThreadPoolPolicy& policy, const SearchServer& search_server, const vector<string>& queries);
+
+// Ставит пакет запросов в пул и сразу возвращает future. Отмена options.cancellation
+// прерывает все запросы пакета, и future завершается исключением QueryCancelled.
+// Сервер должен жить и не меняться, пока future не готов
+future<vector<vector<Document>>> ProcessQueriesAsync(ThreadPool& pool, const SearchServer& search_server, vector<string> queries, const QueryOptions& options = {});
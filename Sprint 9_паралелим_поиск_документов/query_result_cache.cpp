@@ -0,0 +1,82 @@
+#include "query_result_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+const size_t MAX_SHARD_COUNT = 16;
+
+}  // namespace
+
+QueryResultCache::QueryResultCache(size_t capacity) {
+    SetCapacity(capacity);
+}
+
+void QueryResultCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    shards_.clear();
+    // в каждом шарде хотя бы одна запись
+    const size_t shard_count = min(capacity, MAX_SHARD_COUNT);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(make_unique<Shard>());
+        shards_.back()->capacity = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+    }
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key) const {
+    return *shards_[hash<string>{}(key) % shards_.size()];
+}
+
+bool QueryResultCache::Find(const string& key, uint64_t epoch, vector<Document>& documents) const {
+    Shard& shard = GetShard(key);
+    lock_guard<mutex> lock(shard.m);
+    const auto position = shard.positions.find(key);
+    if (position == shard.positions.end()) {
+        ++shard.misses;
+        return false;
+    }
+    const auto entry = position->second;
+    if (entry->epoch != epoch) {
+        shard.positions.erase(position);
+        shard.entries.erase(entry);
+        ++shard.misses;
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    documents = entry->documents;
+    ++shard.hits;
+    return true;
+}
+
+void QueryResultCache::Insert(string key, uint64_t epoch, vector<Document> documents) const {
+    Shard& shard = GetShard(key);
+    lock_guard<mutex> lock(shard.m);
+    const auto position = shard.positions.find(key);
+    if (position != shard.positions.end()) {
+        // тот же запрос успел посчитать другой поток
+        position->second->epoch = epoch;
+        position->second->documents = move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, position->second);
+        return;
+    }
+    if (shard.entries.size() == shard.capacity) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({move(key), epoch, move(documents)});
+    shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+QueryResultCacheStats QueryResultCache::GetStats() const {
+    QueryResultCacheStats stats;
+    for (const auto& shard : shards_) {
+        lock_guard<mutex> lock(shard->m);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.size += shard->entries.size();
+    }
+    return stats;
+}
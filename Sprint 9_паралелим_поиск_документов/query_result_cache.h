@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrent_map.h"
+#include "document.h"
+
+using namespace std;
+
+struct QueryResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t size = 0;
+};
+
+// Кэш результатов запросов с вытеснением давно не запрошенных (LRU).
+// Запись действительна, пока не сменилась эпоха индекса: запись другой эпохи
+// считается промахом и удаляется при обращении. Ключи разложены по шардам
+// со своей блокировкой, поэтому Find и Insert можно вызывать из нескольких потоков
+class QueryResultCache {
+public:
+    // capacity == 0 — кэш выключен
+    explicit QueryResultCache(size_t capacity = 0);
+
+    // копия получает пустой кэш той же ёмкости
+    QueryResultCache(const QueryResultCache& other)
+        : QueryResultCache(other.capacity_) {
+    }
+
+    QueryResultCache& operator=(const QueryResultCache& other) {
+        SetCapacity(other.capacity_);
+        return *this;
+    }
+
+    QueryResultCache(QueryResultCache&&) = default;
+    QueryResultCache& operator=(QueryResultCache&&) = default;
+
+    // Сбрасывает записи и счётчики
+    void SetCapacity(size_t capacity);
+
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    bool IsEnabled() const {
+        return !shards_.empty();
+    }
+
+    // При попадании копирует результат в documents
+    bool Find(const string& key, uint64_t epoch, vector<Document>& documents) const;
+
+    void Insert(string key, uint64_t epoch, vector<Document> documents) const;
+
+    QueryResultCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        string key;
+        uint64_t epoch;
+        vector<Document> documents;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutex m;
+        // в начале списка — последние запрошенные
+        list<Entry> entries;
+        // ключи указывают на строки в узлах списка, которые не перемещаются
+        unordered_map<string_view, list<Entry>::iterator> positions;
+        size_t capacity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    size_t capacity_ = 0;
+    vector<unique_ptr<Shard>> shards_;
+
+    Shard& GetShard(const string& key) const;
+};
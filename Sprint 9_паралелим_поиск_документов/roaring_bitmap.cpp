@@ -0,0 +1,174 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t BITMAP_WORD_COUNT = 65536 / 64;
+
+}  // namespace
+
+void RoaringBitmap::ToBitmap(Container& container) {
+    container.bits.assign(BITMAP_WORD_COUNT, 0);
+    for (const uint16_t low : container.array) {
+        container.bits[low >> 6] |= uint64_t{1} << (low & 63);
+    }
+    container.array.clear();
+    container.array.shrink_to_fit();
+}
+
+void RoaringBitmap::ToArray(Container& container) {
+    container.array.clear();
+    container.array.reserve(container.cardinality);
+    for (size_t word_index = 0; word_index < BITMAP_WORD_COUNT; ++word_index) {
+        for (uint64_t word = container.bits[word_index]; word != 0; word &= word - 1) {
+            container.array.push_back(static_cast<uint16_t>(word_index * 64 + __builtin_ctzll(word)));
+        }
+    }
+    container.bits.clear();
+    container.bits.shrink_to_fit();
+}
+
+void RoaringBitmap::Add(uint32_t value) {
+    const size_t key = value >> 16;
+    const uint16_t low = static_cast<uint16_t>(value);
+    if (containers_.size() <= key) {
+        containers_.resize(key + 1);
+    }
+    Container& container = containers_[key];
+    if (container.IsBitmap()) {
+        uint64_t& word = container.bits[low >> 6];
+        const uint64_t mask = uint64_t{1} << (low & 63);
+        if (word & mask) {
+            return;
+        }
+        word |= mask;
+    } else {
+        // номера документов растут, поэтому обычно это добавление в конец
+        if (container.array.empty() || container.array.back() < low) {
+            container.array.push_back(low);
+        } else {
+            const auto it = lower_bound(container.array.begin(), container.array.end(), low);
+            if (*it == low) {
+                return;
+            }
+            container.array.insert(it, low);
+        }
+        if (container.array.size() > ARRAY_CONTAINER_LIMIT) {
+            ToBitmap(container);
+        }
+    }
+    ++container.cardinality;
+    ++size_;
+}
+
+void RoaringBitmap::Remove(uint32_t value) {
+    const size_t key = value >> 16;
+    if (key >= containers_.size()) {
+        return;
+    }
+    const uint16_t low = static_cast<uint16_t>(value);
+    Container& container = containers_[key];
+    if (container.IsBitmap()) {
+        uint64_t& word = container.bits[low >> 6];
+        const uint64_t mask = uint64_t{1} << (low & 63);
+        if (!(word & mask)) {
+            return;
+        }
+        word &= ~mask;
+        --container.cardinality;
+        // обратно в массив с запасом, чтобы не перестраивать кусок туда-обратно
+        if (container.cardinality <= ARRAY_CONTAINER_LIMIT / 2) {
+            ToArray(container);
+        }
+    } else {
+        const auto it = lower_bound(container.array.begin(), container.array.end(), low);
+        if (it == container.array.end() || *it != low) {
+            return;
+        }
+        container.array.erase(it);
+        --container.cardinality;
+    }
+    --size_;
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const size_t key = value >> 16;
+    if (key >= containers_.size()) {
+        return false;
+    }
+    const uint16_t low = static_cast<uint16_t>(value);
+    const Container& container = containers_[key];
+    if (container.IsBitmap()) {
+        return (container.bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return binary_search(container.array.begin(), container.array.end(), low);
+}
+
+size_t RoaringBitmap::SelectInBitmap(const Container& container, const uint32_t* values, size_t begin, size_t end, uint32_t* selected, size_t selected_count) {
+    const uint64_t* bits = container.bits.data();
+    for (size_t i = begin; i < end; ++i) {
+        const uint16_t low = static_cast<uint16_t>(values[i]);
+        selected[selected_count] = static_cast<uint32_t>(i);
+        selected_count += (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return selected_count;
+}
+
+size_t RoaringBitmap::SelectInArray(const Container& container, const uint32_t* values, size_t begin, size_t end, uint32_t* selected, size_t selected_count) {
+    const uint16_t* array = container.array.data();
+    const size_t array_size = container.array.size();
+    size_t position = 0;
+    for (size_t i = begin; i < end; ++i) {
+        const uint16_t low = static_cast<uint16_t>(values[i]);
+        // значения отсортированы, поэтому позиция в массиве только растёт.
+        // Массив просматривается по 8 элементов: всё, что левее position, меньше low
+        while (position + 8 <= array_size && array[position + 7] < low) {
+            position += 8;
+        }
+        bool found = false;
+#ifdef __SSE2__
+        if (position + 8 <= array_size) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(array + position));
+            const __m128i matches = _mm_cmpeq_epi16(chunk, _mm_set1_epi16(static_cast<short>(low)));
+            found = _mm_movemask_epi8(matches) != 0;
+        } else
+#endif
+        {
+            while (position < array_size && array[position] < low) {
+                ++position;
+            }
+            found = position < array_size && array[position] == low;
+        }
+        selected[selected_count] = static_cast<uint32_t>(i);
+        selected_count += found;
+    }
+    return selected_count;
+}
+
+size_t RoaringBitmap::Select(const uint32_t* values, size_t count, uint32_t* selected) const {
+    size_t selected_count = 0;
+    size_t begin = 0;
+    while (begin < count) {
+        // значения из одного куска идут подряд
+        const size_t key = values[begin] >> 16;
+        size_t end = begin + 1;
+        while (end < count && (values[end] >> 16) == key) {
+            ++end;
+        }
+        if (key < containers_.size() && containers_[key].cardinality > 0) {
+            const Container& container = containers_[key];
+            selected_count = container.IsBitmap()
+                ? SelectInBitmap(container, values, begin, end, selected, selected_count)
+                : SelectInArray(container, values, begin, end, selected, selected_count);
+        }
+        begin = end;
+    }
+    return selected_count;
+}
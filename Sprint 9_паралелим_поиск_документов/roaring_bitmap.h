@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Сжатое множество 32-битных номеров в духе Roaring: номера делятся на
+// куски по 2^16 по старшим битам, и каждый кусок хранится либо отсортированным
+// массивом младших 16 бит, либо битовой картой на 65536 бит, если он плотный.
+// Номера документов плотные, поэтому куски лежат в векторе по старшим битам
+class RoaringBitmap {
+public:
+    void Add(uint32_t value);
+
+    void Remove(uint32_t value);
+
+    bool Contains(uint32_t value) const;
+
+    size_t size() const {
+        return size_;
+    }
+
+    // Записывает в selected позиции тех значений из отсортированного массива values,
+    // которые есть в множестве, и возвращает их число
+    size_t Select(const uint32_t* values, size_t count, uint32_t* selected) const;
+
+private:
+    // Массив превращается в битовую карту, когда перестаёт быть меньше неё
+    static const size_t ARRAY_CONTAINER_LIMIT = 4096;
+
+    struct Container {
+        vector<uint16_t> array;
+        vector<uint64_t> bits;
+        uint32_t cardinality = 0;
+
+        bool IsBitmap() const {
+            return !bits.empty();
+        }
+    };
+
+    vector<Container> containers_;
+    size_t size_ = 0;
+
+    static void ToBitmap(Container& container);
+
+    static void ToArray(Container& container);
+
+    static size_t SelectInArray(const Container& container, const uint32_t* values, size_t begin, size_t end, uint32_t* selected, size_t selected_count);
+
+    static size_t SelectInBitmap(const Container& container, const uint32_t* values, size_t begin, size_t end, uint32_t* selected, size_t selected_count);
+};
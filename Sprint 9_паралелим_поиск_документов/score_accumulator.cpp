@@ -0,0 +1,76 @@
+#include "score_accumulator.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Хеш-таблица на 128 ячеек заполняется не больше чем наполовину
+const int SPARSE_SLOT_BITS = 7;
+const size_t SPARSE_SLOT_COUNT = size_t{1} << SPARSE_SLOT_BITS;
+
+static_assert(SPARSE_SLOT_COUNT >= SPARSE_ACCUMULATOR_LIMIT * 2);
+
+}  // namespace
+
+void ScoreAccumulator::Reset(size_t document_count, size_t candidate_bound) {
+    if (sparse_) {
+        for (const uint32_t slot_index : touched_) {
+            slots_[slot_index] = SparseSlot{};
+        }
+    } else {
+        for (const uint32_t ordinal : touched_) {
+            scores_[ordinal] = 0.0;
+            touched_flags_[ordinal] = 0;
+        }
+    }
+    touched_.clear();
+
+    sparse_ = candidate_bound <= SPARSE_ACCUMULATOR_LIMIT;
+    if (sparse_) {
+        slots_.resize(SPARSE_SLOT_COUNT);
+    } else if (scores_.size() < document_count) {
+        scores_.resize(document_count, 0.0);
+        touched_flags_.resize(document_count, 0);
+    }
+}
+
+size_t ScoreAccumulator::FindSlot(uint32_t ordinal) const {
+    // мультипликативное хеширование Фибоначчи: берём старшие биты произведения
+    size_t slot_index = static_cast<uint32_t>(ordinal * 2654435769u) >> (32 - SPARSE_SLOT_BITS);
+    while (slots_[slot_index].ordinal != ordinal && slots_[slot_index].ordinal != EMPTY_SLOT) {
+        slot_index = (slot_index + 1) & (SPARSE_SLOT_COUNT - 1);
+    }
+    return slot_index;
+}
+
+void ScoreAccumulator::AddSparse(uint32_t ordinal, double score) {
+    const size_t slot_index = FindSlot(ordinal);
+    SparseSlot& slot = slots_[slot_index];
+    if (slot.ordinal == EMPTY_SLOT) {
+        slot.ordinal = ordinal;
+        touched_.push_back(static_cast<uint32_t>(slot_index));
+    }
+    slot.score += score;
+}
+
+void BatchScoreAccumulator::Reset(uint32_t begin, size_t document_count) {
+    for (const uint32_t row : touched_) {
+        fill_n(scores_.begin() + row * BATCH_QUERY_COUNT, BATCH_QUERY_COUNT, 0.0);
+        touched_masks_[row] = 0;
+    }
+    for (const uint32_t row : excluded_) {
+        excluded_masks_[row] = 0;
+    }
+    touched_.clear();
+    excluded_.clear();
+
+    begin_ = begin;
+
+    if (touched_masks_.size() < document_count) {
+        scores_.resize(document_count * BATCH_QUERY_COUNT, 0.0);
+        touched_masks_.resize(document_count, 0);
+        excluded_masks_.resize(document_count, 0);
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "document_columns.h"
+
+using namespace std;
+
+// При такой верхней оценке числа кандидатов баллы копятся в маленькой хеш-таблице
+const size_t SPARSE_ACCUMULATOR_LIMIT = 64;
+// Столько запросов пакетный поиск считает одним накопителем: строка баллов документа занимает одну кэш-линию
+const size_t BATCH_QUERY_COUNT = 8;
+// Пакетный поиск обходит документы полосами по столько номеров: накопитель держит строки
+// одной полосы, 2 МиБ баллов, сколько бы документов ни было в индексе
+const size_t BATCH_TILE_DOCUMENT_COUNT = size_t{1} << 15;
+
+// Накопитель релевантности по внутренним номерам документов.
+// Плотный режим: массив баллов длиной в число документов и список затронутых
+// номеров, так что очистка и обход кандидатов стоят O(число кандидатов).
+// Массивы переиспользуются между запросами, поэтому в цикле подсчёта нет выделений памяти
+class ScoreAccumulator {
+public:
+    // Готовит накопитель к новому запросу. candidate_bound — верхняя оценка
+    // числа кандидатов, например суммарная длина списков вхождений плюс-слов
+    void Reset(size_t document_count, size_t candidate_bound);
+
+    void Add(uint32_t ordinal, double score) {
+        if (sparse_) {
+            AddSparse(ordinal, score);
+            return;
+        }
+        if (!touched_flags_[ordinal]) {
+            touched_flags_[ordinal] = 1;
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += score;
+    }
+
+    // Вызывает function(ordinal, score) для каждого кандидата в порядке первого начисления
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct SparseSlot {
+        uint32_t ordinal = EMPTY_SLOT;
+        double score = 0.0;
+    };
+
+    bool sparse_ = false;
+    vector<double> scores_;
+    vector<uint8_t> touched_flags_;
+    // в разреженном режиме здесь номера занятых ячеек хеш-таблицы
+    vector<uint32_t> touched_;
+    vector<SparseSlot> slots_;
+
+    void AddSparse(uint32_t ordinal, double score);
+
+    size_t FindSlot(uint32_t ordinal) const;
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEach(Function function) const {
+    if (sparse_) {
+        for (const uint32_t slot_index : touched_) {
+            const SparseSlot& slot = slots_[slot_index];
+            function(slot.ordinal, slot.score);
+        }
+        return;
+    }
+    for (const uint32_t ordinal : touched_) {
+        function(ordinal, scores_[ordinal]);
+    }
+}
+
+// Накопитель релевантности для группы до BATCH_QUERY_COUNT запросов. У документа
+// своя строка с ячейкой на каждый запрос, так что вклады одного вхождения
+// во все запросы группы попадают в одну кэш-линию
+class BatchScoreAccumulator {
+public:
+    // Готовит накопитель к документам с номерами из [begin, begin + document_count)
+    void Reset(uint32_t begin, size_t document_count);
+
+    void Add(uint32_t ordinal, size_t query, double score) {
+        const uint32_t row = ordinal - begin_;
+        if (touched_masks_[row] == 0) {
+            touched_.push_back(row);
+        }
+        touched_masks_[row] |= uint8_t{1} << query;
+        scores_[row * BATCH_QUERY_COUNT + query] += score;
+    }
+
+    // Документ не попадёт в результаты запроса, даже если получил баллы
+    void Exclude(uint32_t ordinal, size_t query) {
+        const uint32_t row = ordinal - begin_;
+        excluded_masks_[row] |= uint8_t{1} << query;
+        excluded_.push_back(row);
+    }
+
+    // Вызывает function(query, ordinal, score) для каждого неисключённого кандидата
+    // каждого запроса в порядке первого начисления
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    uint32_t begin_ = 0;
+    vector<double, AlignedAllocator<double>> scores_;
+    vector<uint8_t> touched_masks_;
+    vector<uint8_t> excluded_masks_;
+    vector<uint32_t> touched_;
+    vector<uint32_t> excluded_;
+};
+
+template <typename Function>
+void BatchScoreAccumulator::ForEach(Function function) const {
+    for (const uint32_t row : touched_) {
+        const uint8_t mask = touched_masks_[row] & ~excluded_masks_[row];
+        for (size_t query = 0; query < BATCH_QUERY_COUNT; ++query) {
+            if ((mask >> query) & 1) {
+                function(query, begin_ + row, scores_[row * BATCH_QUERY_COUNT + query]);
+            }
+        }
+    }
+}
@@ -4,6 +4,8 @@
 #include <numeric>
 #include <utility>
 #include <functional>
+#include <stdexcept>
+#include <unordered_set>
 
 using namespace std;
 
@@ -31,62 +33,531 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return accumulate(ratings.begin(), ratings.end(), rating_sum) / static_cast<int>(ratings.size());
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    static map<string_view, double> id_frequencies;
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const{
+    map<string_view, double> word_frequencies;
     
-    if(document_ids_.count(document_id)){
-       
-        auto it = word_to_document_freqs_.begin();
-        for(; it != word_to_document_freqs_.end(); ++it){
-            auto it2 = it->second.find(document_id);
-            if(it2 != it->second.end()){
-               id_frequencies.at(it->first) =  it2->second;
-            }
-        }
+    const auto it = document_ordinals_.find(document_id);
+    if(it == document_ordinals_.end()){
+        return word_frequencies;
     }
-    
-    return id_frequencies;
+    const double inv_word_count = document_columns_.GetInvWordCount(it->second);
+    for(const auto [term_id, term_count] : document_words_freqs_[it->second]){
+        word_frequencies[terms_.GetWord(term_id)] = term_count * inv_word_count;
+    }
+    return word_frequencies;
 }
 
 
 void SearchServer::RemoveDocument(int document_id){
-	if(!count(document_ids_.begin(), document_ids_.end(), document_id)){
-            return;
-        }    
-	auto it = document_words_freqs_.find(document_id);
-        for(auto it2: it->second){
-            word_to_document_freqs_.find(it2.first)->second.erase(document_id);
-        }
-    
-        documents_.erase(document_id);
-        document_ids_.erase(find(document_ids_.begin(), document_ids_.end(), document_id));
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return;
+    }
+    for (const auto [term_id, _] : document_words_freqs_[ordinal_it->second]) {
+        --term_document_counts_[term_id];
+    }
+    MarkDeleted(ordinal_it);
+}
+
+void SearchServer::MarkDeleted(unordered_map<int, uint32_t>::const_iterator ordinal_it) {
+    const int document_id = ordinal_it->first;
+    const uint32_t ordinal = ordinal_it->second;
+    deleted_ordinals_.Set(ordinal);
+    status_documents_[static_cast<size_t>(document_columns_.GetStatus(ordinal))].Remove(ordinal);
+    ++index_epoch_;
+    document_ordinals_.erase(ordinal_it);
+    document_ids_.erase(document_id);
+
+    const size_t deleted_count = document_columns_.size() - document_ordinals_.size();
+    if (deleted_count > compaction_threshold_ * document_columns_.size()) {
+        Compact();
+    }
 }
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
     
-        if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
             throw invalid_argument("Invalid document_id"s);
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), string(move(document)), status});
-    
-        const vector<string_view> words = SplitIntoWordsNoStop(documents_[document_id].text);
+        if (static_cast<size_t>(status) >= DOCUMENT_STATUS_COUNT) {
+            throw invalid_argument("Invalid document status"s);
+        }
+        // слова проверяются до того, как документ попадёт в индекс
+        const vector<string_view> words = SplitIntoWordsNoStop(document);
     
         const double inv_word_count = 1.0 / words.size();
-       
+        const uint64_t text_offset = document_texts_.Append(document);
+        const uint32_t ordinal = document_columns_.Append(document_id, status, ComputeAverageRating(ratings), inv_word_count,
+                                                          text_offset, static_cast<uint32_t>(document.size()));
+        document_ordinals_.emplace(document_id, ordinal);
+        status_documents_[static_cast<size_t>(status)].Add(ordinal);
+        deleted_ordinals_.Resize(document_columns_.size());
+
+        map<TermId, uint32_t> term_counts;
         for (auto word : words) {
-            word_to_document_freqs_[word][document_id] += inv_word_count;
-            document_words_freqs_[document_id][word]+=inv_word_count;
+            ++term_counts[terms_.Intern(word)];
+        }
+        const size_t known_term_count = word_to_document_freqs_.size();
+        word_to_document_freqs_.resize(terms_.size());
+        term_document_counts_.resize(terms_.size());
+        term_max_frequencies_.resize(terms_.size());
+        idf_cache_.Resize(terms_.size());
+        posting_cache_.Resize(terms_.size());
+        if (compress_postings_) {
+            for (size_t term_id = known_term_count; term_id < word_to_document_freqs_.size(); ++term_id) {
+                word_to_document_freqs_[term_id].Compress();
+            }
         }
     
+        vector<TermCount> document_terms;
+        document_terms.reserve(term_counts.size());
+        for (const auto [term_id, term_count] : term_counts) {
+            word_to_document_freqs_[term_id].Insert(ordinal, term_count, term_count * inv_word_count);
+            ++term_document_counts_[term_id];
+            term_max_frequencies_[term_id] = max(term_max_frequencies_[term_id], term_count * inv_word_count);
+            posting_cache_.InvalidateTerm(term_id);
+            document_terms.push_back({term_id, term_count});
+        }
+        document_words_freqs_.Append(document_terms);
+        ++index_epoch_;
+    
         document_ids_.insert(document_id);
 }
 
+void SearchServer::ParseDocumentBatchChunk(const vector<const NewDocument*>& documents, DocumentBatchChunk& chunk) const {
+    const size_t count = chunk.end - chunk.begin;
+    chunk.document_terms.resize(count);
+    chunk.inv_word_counts.resize(count);
+    chunk.errors.resize(count);
+    vector<TermId> local_terms;
+    for (size_t i = 0; i < count; ++i) {
+        vector<string_view> words;
+        try {
+            words = SplitIntoWordsNoStop(documents[chunk.begin + i]->text);
+        } catch (...) {
+            chunk.errors[i] = current_exception();
+            continue;
+        }
+        chunk.inv_word_counts[i] = 1.0 / words.size();
+
+        local_terms.clear();
+        for (const string_view word : words) {
+            const auto [position, inserted] = chunk.local_ids.emplace(word, static_cast<TermId>(chunk.local_words.size()));
+            if (inserted) {
+                chunk.local_words.push_back(word);
+            }
+            local_terms.push_back(position->second);
+        }
+        sort(local_terms.begin(), local_terms.end());
+        vector<TermCount>& document_terms = chunk.document_terms[i];
+        for (const TermId term_id : local_terms) {
+            if (document_terms.empty() || document_terms.back().term_id != term_id) {
+                document_terms.push_back({term_id, 0});
+            }
+            ++document_terms.back().term_count;
+        }
+    }
+}
+
+void SearchServer::ValidateDocumentBatch(const vector<const NewDocument*>& documents, const vector<DocumentBatchChunk>& chunks) const {
+    unordered_set<int> batch_ids;
+    for (const DocumentBatchChunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.end - chunk.begin; ++i) {
+            const NewDocument& document = *documents[chunk.begin + i];
+            if (document.id < 0 || document_ordinals_.count(document.id) > 0 || !batch_ids.insert(document.id).second) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+            if (static_cast<size_t>(document.status) >= DOCUMENT_STATUS_COUNT) {
+                throw invalid_argument("Invalid document status"s);
+            }
+            if (chunk.errors[i]) {
+                rethrow_exception(chunk.errors[i]);
+            }
+        }
+    }
+}
 
+void SearchServer::InternDocumentBatchTerms(vector<DocumentBatchChunk>& chunks) {
+    for (DocumentBatchChunk& chunk : chunks) {
+        chunk.global_ids.reserve(chunk.local_words.size());
+        for (const string_view word : chunk.local_words) {
+            chunk.global_ids.push_back(terms_.Intern(word));
+        }
+    }
+}
 
-vector<Document> SearchServer::FindTopDocuments( const string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
+void SearchServer::TranslateDocumentBatchChunk(DocumentBatchChunk& chunk) {
+    for (vector<TermCount>& document_terms : chunk.document_terms) {
+        for (TermCount& term : document_terms) {
+            term.term_id = chunk.global_ids[term.term_id];
+        }
+        sort(document_terms.begin(), document_terms.end(), [](const TermCount& lhs, const TermCount& rhs) {
+            return lhs.term_id < rhs.term_id;
+        });
+    }
+}
+
+SearchServer::DocumentBatchPostings SearchServer::AppendDocumentBatch(const vector<const NewDocument*>& documents, const vector<DocumentBatchChunk>& chunks) {
+    const size_t known_term_count = word_to_document_freqs_.size();
+    word_to_document_freqs_.resize(terms_.size());
+    term_document_counts_.resize(terms_.size());
+    term_max_frequencies_.resize(terms_.size());
+    idf_cache_.Resize(terms_.size());
+    posting_cache_.Resize(terms_.size());
+    if (compress_postings_) {
+        for (size_t term_id = known_term_count; term_id < word_to_document_freqs_.size(); ++term_id) {
+            word_to_document_freqs_[term_id].Compress();
+        }
+    }
+
+    vector<uint32_t> ordinals;
+    ordinals.reserve(documents.size());
+    vector<size_t> term_positions(terms_.size(), 0);
+    for (const DocumentBatchChunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.end - chunk.begin; ++i) {
+            const NewDocument& document = *documents[chunk.begin + i];
+            const uint64_t text_offset = document_texts_.Append(document.text);
+            const uint32_t ordinal = document_columns_.Append(document.id, document.status, ComputeAverageRating(document.ratings), chunk.inv_word_counts[i],
+                                                              text_offset, static_cast<uint32_t>(document.text.size()));
+            ordinals.push_back(ordinal);
+            document_ordinals_.emplace(document.id, ordinal);
+            status_documents_[static_cast<size_t>(document.status)].Add(ordinal);
+            document_words_freqs_.Append(chunk.document_terms[i]);
+            document_ids_.insert(document.id);
+            for (const TermCount& term : chunk.document_terms[i]) {
+                ++term_positions[term.term_id];
+            }
+        }
+    }
+    deleted_ordinals_.Resize(document_columns_.size());
+
+    // подсчёт вхождений по словам превращается в начала их отрезков
+    DocumentBatchPostings postings;
+    size_t posting_count = 0;
+    for (TermId term_id = 0; term_id < term_positions.size(); ++term_id) {
+        const size_t term_posting_count = term_positions[term_id];
+        if (term_posting_count == 0) {
+            continue;
+        }
+        postings.term_ids.push_back(term_id);
+        postings.offsets.push_back(posting_count);
+        term_positions[term_id] = posting_count;
+        posting_count += term_posting_count;
+    }
+    postings.offsets.push_back(posting_count);
+    postings.ordinals.resize(posting_count);
+    postings.term_counts.resize(posting_count);
+    postings.term_frequencies.resize(posting_count);
+
+    size_t document_index = 0;
+    for (const DocumentBatchChunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.end - chunk.begin; ++i, ++document_index) {
+            for (const auto [term_id, term_count] : chunk.document_terms[i]) {
+                const size_t position = term_positions[term_id]++;
+                postings.ordinals[position] = ordinals[document_index];
+                postings.term_counts[position] = term_count;
+                postings.term_frequencies[position] = term_count * chunk.inv_word_counts[i];
+            }
+        }
+    }
+    return postings;
+}
+
+void SearchServer::InsertDocumentBatchPostings(const DocumentBatchPostings& postings, size_t term_index) {
+    const TermId term_id = postings.term_ids[term_index];
+    PostingList& term_postings = word_to_document_freqs_[term_id];
+    double max_frequency = term_max_frequencies_[term_id];
+    for (size_t i = postings.offsets[term_index]; i < postings.offsets[term_index + 1]; ++i) {
+        term_postings.Insert(postings.ordinals[i], postings.term_counts[i], postings.term_frequencies[i]);
+        max_frequency = max(max_frequency, postings.term_frequencies[i]);
+    }
+    term_max_frequencies_[term_id] = max_frequency;
+    term_document_counts_[term_id] += postings.offsets[term_index + 1] - postings.offsets[term_index];
+    posting_cache_.InvalidateTerm(term_id);
+}
+
+
+
+string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return {};
+    }
+    return document_texts_.Get(document_columns_.GetTextOffset(it->second), document_columns_.GetTextLength(it->second));
+}
+
+vector<NewDocument> SearchServer::GetDocuments() const {
+    vector<NewDocument> documents;
+    documents.reserve(document_ordinals_.size());
+    for (uint32_t ordinal = 0; ordinal < document_columns_.size(); ++ordinal) {
+        const int document_id = document_columns_.GetId(ordinal);
+        // номер удалённого документа может принадлежать его более позднему двойнику
+        const auto it = document_ordinals_.find(document_id);
+        if (it == document_ordinals_.end() || it->second != ordinal) {
+            continue;
+        }
+        documents.push_back({document_id, document_texts_.Get(document_columns_.GetTextOffset(ordinal), document_columns_.GetTextLength(ordinal)),
+                             document_columns_.GetStatus(ordinal), {document_columns_.GetRating(ordinal)}});
+    }
+    return documents;
+}
+
+uint32_t SearchServer::GetWordDocumentCount(string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    return term_id == NO_TERM ? 0 : term_document_counts_[term_id];
+}
+
+void SearchServer::SetTermStatistics(shared_ptr<const TermStatistics> statistics) {
+    term_statistics_ = move(statistics);
+    ++index_epoch_;
+}
+
+void SearchServer::SetCompactionThreshold(double deleted_fraction) {
+    compaction_threshold_ = deleted_fraction;
+}
+
+void SearchServer::Compact() {
+    // новые номера слов, которые ещё есть в документах, в прежнем порядке
+    vector<TermId> term_ids(terms_.size(), NO_TERM);
+    TermDictionary terms;
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (term_document_counts_[term_id] > 0) {
+            term_ids[term_id] = terms.Intern(terms_.GetWord(term_id));
+        }
+    }
+
+    // живые документы в прежнем порядке
+    vector<uint32_t> ordinals(document_columns_.size(), 0);
+    DocumentColumns document_columns;
+    TextArena document_texts;
+    ForwardIndex document_words_freqs;
+    array<RoaringBitmap, DOCUMENT_STATUS_COUNT> status_documents;
+    vector<TermCount> document_terms;
+    for (uint32_t ordinal = 0; ordinal < document_columns_.size(); ++ordinal) {
+        if (deleted_ordinals_.Test(ordinal)) {
+            continue;
+        }
+        const string_view text = document_texts_.Get(document_columns_.GetTextOffset(ordinal), document_columns_.GetTextLength(ordinal));
+        const DocumentStatus status = document_columns_.GetStatus(ordinal);
+        ordinals[ordinal] = document_columns.Append(document_columns_.GetId(ordinal), status, document_columns_.GetRating(ordinal),
+                                                    document_columns_.GetInvWordCount(ordinal), document_texts.Append(text),
+                                                    static_cast<uint32_t>(text.size()));
+        status_documents[static_cast<size_t>(status)].Add(ordinals[ordinal]);
+        document_terms.clear();
+        for (const auto [term_id, term_count] : document_words_freqs_[ordinal]) {
+            document_terms.push_back({term_ids[term_id], term_count});
+        }
+        document_words_freqs.Append(document_terms);
+    }
+
+    vector<PostingList> word_to_document_freqs(terms.size());
+    vector<uint32_t> term_document_counts(terms.size());
+    vector<double> term_max_frequencies(terms.size(), 0.0);
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        const TermId new_term_id = term_ids[term_id];
+        if (new_term_id == NO_TERM) {
+            continue;
+        }
+        PostingList& postings = word_to_document_freqs[new_term_id];
+        if (compress_postings_) {
+            postings.Compress();
+        }
+        word_to_document_freqs_[term_id].ForEach([&](uint32_t ordinal, uint32_t term_count) {
+            if (deleted_ordinals_.Test(ordinal)) {
+                return;
+            }
+            const double term_frequency = term_count * document_columns_.GetInvWordCount(ordinal);
+            postings.Insert(ordinals[ordinal], term_count, term_frequency);
+            // оценка по живым документам точнее прежней
+            term_max_frequencies[new_term_id] = max(term_max_frequencies[new_term_id], term_frequency);
         });
+        term_document_counts[new_term_id] = term_document_counts_[term_id];
+    }
+
+    terms_ = move(terms);
+    word_to_document_freqs_ = move(word_to_document_freqs);
+    term_document_counts_ = move(term_document_counts);
+    term_max_frequencies_ = move(term_max_frequencies);
+    document_columns_ = move(document_columns);
+    document_texts_ = move(document_texts);
+    document_words_freqs_ = move(document_words_freqs);
+    status_documents_ = move(status_documents);
+    for (auto& [document_id, ordinal] : document_ordinals_) {
+        ordinal = ordinals[ordinal];
+    }
+    deleted_ordinals_ = OrdinalBitset();
+    deleted_ordinals_.Resize(document_columns_.size());
+
+    // номера слов сменились: кэши строятся заново
+    idf_cache_ = IdfCache();
+    idf_cache_.Resize(terms_.size());
+    posting_cache_ = PostingCache(posting_cache_);
+    posting_cache_.Resize(terms_.size());
+    ++index_epoch_;
+    // в отображённом снимке больше ничего не читается
+    snapshot_file_.reset();
+}
+
+void SearchServer::CompactDocumentTexts() {
+    vector<bool> is_live(document_columns_.size(), false);
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        is_live[ordinal] = true;
+    }
+
+    // тексты остаются в порядке добавления документов
+    TextArena compacted;
+    for (uint32_t ordinal = 0; ordinal < is_live.size(); ++ordinal) {
+        if (!is_live[ordinal]) {
+            document_columns_.SetText(ordinal, 0, 0);
+            continue;
+        }
+        const string_view text = document_texts_.Get(document_columns_.GetTextOffset(ordinal), document_columns_.GetTextLength(ordinal));
+        document_columns_.SetText(ordinal, compacted.Append(text), static_cast<uint32_t>(text.size()));
+    }
+    document_texts_ = move(compacted);
+}
+
+void SearchServer::SetPostingCompression(bool enabled) {
+    compress_postings_ = enabled;
+    for (auto& postings : word_to_document_freqs_) {
+        if (enabled) {
+            postings.Compress();
+        } else {
+            postings.Decompress();
+        }
+    }
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_.SetCapacity(capacity);
+}
+
+void SearchServer::SetPostingCacheMemoryLimit(size_t memory_limit) {
+    posting_cache_.SetMemoryLimit(memory_limit);
+    // у снимка версии слов ещё не заведены
+    posting_cache_.Resize(terms_.size());
+}
+
+string SearchServer::MakeResultCacheKey(const Query& query, DocumentStatus status, size_t result_count) {
+    // слова запроса уже отсортированы и без повторов; длина плюс-слов отделяет их от минус-слов
+    const uint32_t plus_count = static_cast<uint32_t>(query.plus_words.size());
+    const uint64_t count = result_count;
+    string key;
+    key.reserve(1 + sizeof(count) + sizeof(plus_count) + (query.plus_words.size() + query.minus_words.size()) * sizeof(TermId));
+    key.push_back(static_cast<char>(status));
+    key.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    key.append(reinterpret_cast<const char*>(&plus_count), sizeof(plus_count));
+    key.append(reinterpret_cast<const char*>(query.plus_words.data()), query.plus_words.size() * sizeof(TermId));
+    key.append(reinterpret_cast<const char*>(query.minus_words.data()), query.minus_words.size() * sizeof(TermId));
+    return key;
+}
+
+namespace {
+
+struct SnapshotSettings {
+    uint32_t compress_postings;
+    uint32_t reserved;
+};
+
+}  // namespace
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    SnapshotWriter writer(path);
+
+    const SnapshotSettings settings{compress_postings_, 0};
+    writer.WriteSection(SnapshotSection::SETTINGS, &settings, 1);
+    writer.WriteStringTable(SnapshotSection::STOP_WORD_OFFSETS, SnapshotSection::STOP_WORD_CHARS,
+                            vector<string_view>(stop_words_.begin(), stop_words_.end()));
+
+    terms_.Save(writer);
+    writer.WriteSection(SnapshotSection::TERM_DOCUMENT_COUNTS, term_document_counts_.data(), term_document_counts_.size());
+    writer.WriteSection(SnapshotSection::TERM_MAX_FREQUENCIES, term_max_frequencies_.data(), term_max_frequencies_.size());
+    PostingList::SaveAll(word_to_document_freqs_, writer);
+
+    document_columns_.Save(writer);
+    document_texts_.Save(writer);
+    document_words_freqs_.Save(writer);
+
+    vector<uint32_t> live_ordinals;
+    live_ordinals.reserve(document_ordinals_.size());
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        live_ordinals.push_back(ordinal);
+    }
+    sort(live_ordinals.begin(), live_ordinals.end());
+    writer.WriteSection(SnapshotSection::LIVE_ORDINALS, live_ordinals.data(), live_ordinals.size());
+
+    writer.Finish();
+}
+
+SearchServer SearchServer::OpenSnapshot(const string& path, const SnapshotOpenOptions& options) {
+    const SnapshotReader reader(path, options.verify_checksum);
+
+    const auto stop_words = reader.GetStringTable(SnapshotSection::STOP_WORD_OFFSETS, SnapshotSection::STOP_WORD_CHARS);
+    SearchServer server(stop_words);
+    server.snapshot_file_ = reader.GetFile();
+
+    const auto settings = reader.GetArray<SnapshotSettings>(SnapshotSection::SETTINGS);
+    if (settings.size() != 1) {
+        throw runtime_error("Snapshot settings are corrupted"s);
+    }
+    server.compress_postings_ = settings[0].compress_postings != 0;
+
+    // без проверки контрольной суммы каждое смещение и номер проверяются до того, как по ним читать
+    server.document_columns_.Load(reader);
+    server.document_texts_.Load(reader);
+    server.terms_.Load(reader);
+    server.document_words_freqs_.Load(reader, server.terms_.size(), options.verify_checksum);
+    if (server.document_words_freqs_.size() != server.document_columns_.size()) {
+        throw runtime_error("Snapshot document sections are inconsistent"s);
+    }
+
+    const auto term_document_counts = reader.GetArray<uint32_t>(SnapshotSection::TERM_DOCUMENT_COUNTS);
+    server.term_document_counts_.assign(term_document_counts.begin(), term_document_counts.end());
+    const auto term_max_frequencies = reader.GetArray<double>(SnapshotSection::TERM_MAX_FREQUENCIES);
+    server.term_max_frequencies_.assign(term_max_frequencies.begin(), term_max_frequencies.end());
+    server.word_to_document_freqs_ = PostingList::LoadAll(reader, server.document_columns_.size(), options.verify_checksum);
+    if (server.term_document_counts_.size() != server.terms_.size() || server.term_max_frequencies_.size() != server.terms_.size()
+        || server.word_to_document_freqs_.size() != server.terms_.size()) {
+        throw runtime_error("Snapshot term sections are inconsistent"s);
+    }
+    server.idf_cache_.Resize(server.terms_.size());
+
+    const auto live_ordinals = reader.GetArray<uint32_t>(SnapshotSection::LIVE_ORDINALS);
+    server.document_ordinals_.reserve(live_ordinals.size());
+    server.deleted_ordinals_.Resize(server.document_columns_.size());
+    // номера между живыми принадлежат удалённым документам
+    uint32_t next_ordinal = 0;
+    for (const uint32_t ordinal : live_ordinals) {
+        if (ordinal >= server.document_columns_.size() || ordinal < next_ordinal
+            || static_cast<size_t>(server.document_columns_.GetStatus(ordinal)) >= DOCUMENT_STATUS_COUNT
+            || !server.document_texts_.Contains(server.document_columns_.GetTextOffset(ordinal), server.document_columns_.GetTextLength(ordinal))) {
+            throw runtime_error("Snapshot live documents are corrupted"s);
+        }
+        for (; next_ordinal < ordinal; ++next_ordinal) {
+            server.deleted_ordinals_.Set(next_ordinal);
+        }
+        next_ordinal = ordinal + 1;
+        const int document_id = server.document_columns_.GetId(ordinal);
+        server.document_ordinals_.emplace(document_id, ordinal);
+        server.document_ids_.insert(server.document_ids_.end(), document_id);
+        server.status_documents_[static_cast<size_t>(server.document_columns_.GetStatus(ordinal))].Add(ordinal);
+    }
+    for (; next_ordinal < server.document_columns_.size(); ++next_ordinal) {
+        server.deleted_ordinals_.Set(next_ordinal);
+    }
+
+    if (options.prefault) {
+        MappedFile::PrefaultAsync(reader.GetFile());
+    }
+    return server;
+}
+
+vector<Document> SearchServer::FindTopDocuments( const string_view raw_query, DocumentStatus status) const {
+        return FindTopDocuments(raw_query, StatusPredicate{status});
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, const QueryOptions& options) const {
+    return FindTopDocuments(raw_query, StatusPredicate{status}, options);
 }
 
 
@@ -131,10 +602,17 @@ SearchServer::Query SearchServer::ParseQuery(bool flag, const string_view text)
         const auto query_word = ParseQueryWord(word);
         
         if (!query_word.is_stop) {
+            // слова, которых нет в живых документах, ни с одним документом не совпадут.
+            // Удалённые документы ещё лежат в списках, но IDF такого слова бесконечен,
+            // и нулевая частота слова в чужом документе пары из кэша дала бы NaN
+            const TermId term_id = terms_.Find(query_word.data);
+            if (term_id == NO_TERM || term_document_counts_[term_id] == 0) {
+                continue;
+            }
             if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+                result.minus_words.push_back(term_id);
             } else {
-                result.plus_words.push_back(query_word.data);
+                result.plus_words.push_back(term_id);
             }
         }
     } 
@@ -151,6 +629,63 @@ SearchServer::Query SearchServer::ParseQuery(bool flag, const string_view text)
         return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+size_t SearchServer::CountPostings(const vector<TermId>& term_ids) const {
+    size_t count = 0;
+    for (const TermId term_id : term_ids) {
+        count += word_to_document_freqs_[term_id].size();
+    }
+    return count;
+}
+
+vector<SearchServer::PlusTermGroup> SearchServer::GroupPlusWords(const vector<TermId>& plus_words) const {
+    vector<PlusTermGroup> groups;
+    groups.reserve(plus_words.size());
+    for (size_t i = 0; i < plus_words.size(); ++i) {
+        if (i + 1 < plus_words.size()) {
+            if (auto pair = posting_cache_.GetPair(word_to_document_freqs_, plus_words[i], plus_words[i + 1])) {
+                groups.push_back({plus_words[i], plus_words[i + 1], move(pair)});
+                ++i;
+                continue;
+            }
+        }
+        groups.push_back({plus_words[i], NO_TERM, nullptr});
+    }
+    return groups;
+}
+
+ThreadLocalPool<OrdinalBitset>::Lease SearchServer::CollectExclusions(const vector<TermId>& minus_words, const CancellationToken& cancellation) const {
+    auto exclusions = ThreadLocalPool<OrdinalBitset>::Acquire();
+    exclusions->Clear();
+    exclusions->Resize(document_columns_.size());
+    // одно минус-слово и так обходится одним списком
+    if (minus_words.size() > 1) {
+        if (const auto cached = posting_cache_.GetUnion(word_to_document_freqs_, minus_words)) {
+            const vector<uint32_t>& ordinals = cached->ordinals;
+            for (size_t i = 0; i < ordinals.size(); ++i) {
+                if (i % POSTING_BLOCK_SIZE == 0) {
+                    cancellation.ThrowIfCancelled();
+                }
+                exclusions->Set(ordinals[i]);
+            }
+            return exclusions;
+        }
+    }
+    for (const TermId term_id : minus_words) {
+        word_to_document_freqs_[term_id].ForEachBlock([&](const uint32_t* ordinals, const uint32_t*, size_t count) {
+            cancellation.ThrowIfCancelled();
+            for (size_t i = 0; i < count; ++i) {
+                exclusions->Set(ordinals[i]);
+            }
+        });
+    }
+    return exclusions;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+        return idf_cache_.Get(term_id, index_epoch_, [this, term_id] {
+            if (term_statistics_) {
+                return term_statistics_->ComputeInverseDocumentFreq(terms_.GetWord(term_id));
+            }
+            return log(GetDocumentCount() * 1.0 / term_document_counts_[term_id]);
+        });
 }
@@ -1,10 +1,18 @@
 #pragma once
+#include <array>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <execution>
 #include <cstddef>
+#include <cmath>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <future>
 #include <iostream>
 #include <time.h>
 
@@ -12,6 +20,23 @@
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include "document_columns.h"
+#include "idf_cache.h"
+#include "forward_index.h"
+#include "index_snapshot.h"
+#include "text_arena.h"
+#include "top_k.h"
+#include "score_accumulator.h"
+#include "ordinal_bitset.h"
+#include "thread_local_pool.h"
+#include "roaring_bitmap.h"
+#include "thread_pool.h"
+#include "cancellation.h"
+#include "query_result_cache.h"
+#include "posting_cache.h"
+#include "term_statistics.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
@@ -19,13 +44,60 @@ const float EPS = 1e-6;
 
 using namespace std;
 
+enum class ScoringMode {
+    // каждое вхождение каждого плюс-слова получает балл
+    EXHAUSTIVE,
+    // обход по документам с отсечением MaxScore: документы, которые по верхней
+    // оценке не попадают в лучшие, не досчитываются. Результат тот же
+    MAX_SCORE,
+};
+
+// Как параллельная версия поиска делит работу между потоками
+enum class ParallelMode {
+    // каждое плюс-слово разбирается своим потоком
+    BY_WORDS,
+    // номера документов делятся на диапазоны, каждый поток считает свой диапазон
+    // целиком со своим накопителем и своими лучшими, которые затем сливаются
+    BY_DOCUMENT_RANGES,
+};
+
+// Параметры одного поискового запроса
+struct QueryOptions {
+    // сколько лучших документов вернуть
+    size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT;
+    ScoringMode scoring_mode = ScoringMode::EXHAUSTIVE;
+    // учитывается только параллельными версиями FindTopDocuments
+    ParallelMode parallel_mode = ParallelMode::BY_WORDS;
+    // число диапазонов для BY_DOCUMENT_RANGES; 0 — по числу ядер
+    size_t shard_count = 0;
+    // отменённый запрос бросает QueryCancelled, пройдя не больше блока вхождений
+    CancellationToken cancellation;
+};
+
+struct SnapshotOpenOptions {
+    // проверять контрольную сумму: требует прочитать файл целиком
+    bool verify_checksum = true;
+    // подгружать страницы файла в фоне, чтобы первые запросы не ждали диска
+    bool prefault = false;
+};
+
+// Предикат "документ имеет заданный статус". Поиск узнаёт его по типу
+// и пересекает блоки вхождений с множеством документов статуса, а не вызывает функцию на каждое вхождение
+struct StatusPredicate {
+    DocumentStatus status;
+
+    bool operator()(int, DocumentStatus document_status, int) const {
+        return document_status == status;
+    }
+};
+
 
 class SearchServer {
     private:
     
     struct Query {
-        vector<string_view> minus_words;
-        vector<string_view> plus_words;
+        vector<TermId> minus_words;
+        vector<TermId> plus_words;
     };
     
     struct QueryWord {
@@ -36,31 +108,31 @@ class SearchServer {
 
 
 public:
-    map<string_view, map<int, double>> word_to_document_freqs_;
-    map<int, map<string_view, double>> document_words_freqs_;
+    vector<PostingList> word_to_document_freqs_;
+    // прямой индекс по внутреннему номеру документа
+    ForwardIndex document_words_freqs_;
     set<int> document_ids_;
     
+    // Документ помечается удалённым: его вхождения остаются в списках, но пропускаются
+    // при поиске, а IDF слов меняется сразу. Ранее полученные string_view на тексты и слова
+    // остаются действительными. Место удалённых освобождает Compact, который по умолчанию
+    // вызывается только явно. Если порог задан SetCompactionThreshold, удаление, перешедшее
+    // его, само вызывает Compact: тогда string_view недействительны после любого удаления
     void RemoveDocument(int document_id);
     
     template<typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id){
-        if(!document_ids_.count(document_id)){
+        const auto ordinal_it = document_ordinals_.find(document_id);
+        if (ordinal_it == document_ordinals_.end()) {
             return;
         }
         
-        vector<string_view> words(document_words_freqs_.at(document_id).size());
-        auto it = document_words_freqs_.at(document_id);
-        transform(policy, it.begin(), it.end(), words.begin(), [](auto& pair) {
-            return pair.first;
+        const uint32_t ordinal = ordinal_it->second;
+        const auto terms = document_words_freqs_[ordinal];
+        ParallelForEach(policy, terms.begin(), terms.end(), [this](const TermCount& term) {
+            --term_document_counts_[term.term_id];
         });
-        
-        for_each(policy, words.begin(), words.end(), [this, document_id](auto word) {
-            auto x = word_to_document_freqs_.find(word);
-            x->second.erase(document_id);
-          
-        });
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+        MarkDeleted(ordinal_it);
     }
     
     
@@ -75,6 +147,85 @@ public:
     
     void AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings);
 
+    // Добавляет документы диапазона так же, как AddDocument в их порядке, но тексты разбираются
+    // параллельно, а списки вхождений слов пополняются каждый своим потоком.
+    // Ошибки те же, что у AddDocument, для первого по порядку неверного документа; тогда не добавляется ни один
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentRange& documents);
+
+    template <typename DocumentRange>
+    void AddDocuments(const DocumentRange& documents) {
+        AddDocuments(execution::seq, documents);
+    }
+
+    // Хранить списки вхождений в сжатом виде: меньше памяти, но блоки распаковываются при каждом обходе
+    void SetPostingCompression(bool enabled);
+
+    bool IsPostingCompressionEnabled() const {
+        return compress_postings_;
+    }
+
+    // Сохраняет индекс в двоичный снимок, который можно открыть без разбора текстов
+    void SaveSnapshot(const string& path) const;
+
+    // Списки вхождений, столбцы, прямой индекс и тексты читаются прямо из
+    // отображённого файла и копируются в память только при изменении индекса.
+    // Заново строятся лишь хеш-таблицы слов и идентификаторов документов.
+    // Без проверки контрольной суммы блоки вхождений и номера слов сверяются с границами при первом
+    // чтении, и испорченный снимок может бросить runtime_error уже из поиска, а не отсюда
+    static SearchServer OpenSnapshot(const string& path, const SnapshotOpenOptions& options = {});
+
+    // Текст документа; пустая строка, если документа нет
+    string_view GetDocumentText(int document_id) const;
+
+    // Живые документы в порядке добавления. Тексты указывают в арену сервера
+    // и действительны до следующего изменения индекса
+    vector<NewDocument> GetDocuments() const;
+
+    // IDF слов считается по общей статистике нескольких индексов, а не по своим документам,
+    // чтобы релевантности из разных индексов были сравнимы. Владелец статистики вызывает
+    // метод снова после изменения любого из её индексов: это сбрасывает кэши IDF и результатов.
+    // nullptr возвращает расчёт по своим документам
+    void SetTermStatistics(shared_ptr<const TermStatistics> statistics);
+
+    // Доля удалённых среди всех внутренних номеров документов, после которой RemoveDocument
+    // уплотняет индекс. Уплотнение проходит по всему индексу, и удаление, на которое оно
+    // пришлось, ждёт его. 1 и больше (по умолчанию) — уплотнять только явным вызовом Compact
+    void SetCompactionThreshold(double deleted_fraction);
+
+    // Выбрасывает вхождения удалённых документов и слова, которых не осталось ни в одном документе,
+    // и перенумеровывает документы и слова в прежнем порядке. Релевантность и выдача не меняются.
+    // Ранее полученные string_view на тексты и слова после этого недействительны
+    void Compact();
+
+    // Переписывает тексты живых документов в новую арену и освобождает место удалённых.
+    // Ранее полученные string_view на тексты после этого недействительны
+    void CompactDocumentTexts();
+
+    // Кэш результатов FindTopDocuments для запросов с фильтром по статусу. Ключ — разобранный
+    // запрос без повторов, статус и число результатов; записи устаревают при AddDocument и RemoveDocument.
+    // capacity == 0 выключает кэш
+    void SetResultCacheCapacity(size_t capacity);
+
+    QueryResultCacheStats GetResultCacheStats() const {
+        return result_cache_.GetStats();
+    }
+
+    // Кэш объединённых списков вхождений для частых пар плюс-слов и наборов минус-слов.
+    // Запрос, первые два плюс-слова которого образуют такую пару, обходит один готовый список вместо двух.
+    // memory_limit == 0 выключает кэш
+    void SetPostingCacheMemoryLimit(size_t memory_limit);
+
+    PostingCacheStats GetPostingCacheStats() const {
+        return posting_cache_.GetStats();
+    }
+
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentPredicate document_predicate, const QueryOptions& options) const;
+
+    template <typename ExecutionPolicy>
+    vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentStatus status, const QueryOptions& options) const;
 
     template <typename DocumentPredicate, typename ExecutionPolicy>
     vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentPredicate document_predicate) const;
@@ -85,21 +236,73 @@ public:
     template <typename ExecutionPolicy>
     vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query) const;
     
+    template <typename DocumentPredicate>
+    vector<Document> FindTopDocuments(const string_view raw_query, DocumentPredicate document_predicate, const QueryOptions& options) const;
+
+    vector<Document> FindTopDocuments(const string_view raw_query, DocumentStatus status, const QueryOptions& options) const;
+
     template <typename DocumentPredicate>
     vector<Document> FindTopDocuments(const string_view raw_query, DocumentPredicate document_predicate) const;
     
     vector<Document>FindTopDocuments(const string_view raw_query, DocumentStatus status) const;
     
     vector<Document> FindTopDocuments(const string_view raw_query) const;
+
+    // Ставит запрос в пул и сразу возвращает future. Запрос выполняется одним потоком пула;
+    // отменённый через options.cancellation завершает future исключением QueryCancelled.
+    // Сервер должен жить и не меняться, пока future не готов
+    template <typename DocumentPredicate>
+    future<vector<Document>> FindTopDocumentsAsync(ThreadPool& pool, string raw_query, DocumentPredicate document_predicate, const QueryOptions& options = {}) const;
+
+    future<vector<Document>> FindTopDocumentsAsync(ThreadPool& pool, string raw_query, DocumentStatus status, const QueryOptions& options = {}) const {
+        return FindTopDocumentsAsync(pool, move(raw_query), StatusPredicate{status}, options);
+    }
+
+    future<vector<Document>> FindTopDocumentsAsync(ThreadPool& pool, string raw_query, const QueryOptions& options = {}) const {
+        return FindTopDocumentsAsync(pool, move(raw_query), DocumentStatus::ACTUAL, options);
+    }
+
+    // Выполняет пакет запросов, читая список вхождений каждого слова один раз на весь пакет.
+    // Результаты те же, что у FindTopDocuments для каждого запроса по отдельности.
+    // Из options учитываются max_result_count и cancellation; по политике параллельно
+    // обрабатываются группы по BATCH_QUERY_COUNT запросов
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    vector<vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const vector<string>& raw_queries, DocumentPredicate document_predicate,
+                                                   const QueryOptions& options = {}) const;
+
+    template <typename ExecutionPolicy>
+    vector<vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const vector<string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                   const QueryOptions& options = {}) const {
+        return FindTopDocumentsBatch(policy, raw_queries, StatusPredicate{status}, options);
+    }
+
+    vector<vector<Document>> FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL, const QueryOptions& options = {}) const {
+        return FindTopDocumentsBatch(execution::seq, raw_queries, StatusPredicate{status}, options);
+    }
     
     template <typename DocumentPredicate>
     
     vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const; 
 
+    // Порядок выдачи: по убыванию релевантности, при почти равной релевантности по убыванию рейтинга
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+        if (abs(lhs.relevance - rhs.relevance) < EPS) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.relevance > rhs.relevance;
+    }
+
     int GetDocumentCount() const {
-        return documents_.size();
+        return document_ordinals_.size();
+    }
+
+    int GetDocumentCount(DocumentStatus status) const {
+        return status_documents_.at(static_cast<size_t>(status)).size();
     }
 
+    // Число документов со словом; 0, если слова нет в индексе
+    uint32_t GetWordDocumentCount(string_view word) const;
+
     const set<int>::iterator begin(){
         return document_ids_.begin();
     };
@@ -113,75 +316,172 @@ public:
   
     tuple<vector<string_view>, DocumentStatus> MatchDocument(const execution::sequenced_policy&, const string_view raw_query, int document_id) const{
         
-        if (documents_.count(document_id) == 0) {
+        const auto ordinal_it = document_ordinals_.find(document_id);
+        if (ordinal_it == document_ordinals_.end()) {
             throw std::out_of_range("Invalid id");
         }
+        const uint32_t ordinal = ordinal_it->second;
         
         const auto query = ParseQuery(true, raw_query);
         
         vector<string_view> matched_words;
-        for (const auto word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return {vector<string_view> {}, documents_.at(document_id).status};
+        for (const TermId term_id : query.minus_words) {
+            if (word_to_document_freqs_[term_id].Contains(ordinal)) {
+                return {vector<string_view> {}, document_columns_.GetStatus(ordinal)};
             }
         }
         
-        for (const auto word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.push_back(word);
+        for (const TermId term_id : query.plus_words) {
+            if (word_to_document_freqs_[term_id].Contains(ordinal)) {
+                matched_words.push_back(terms_.GetWord(term_id));
             }
         }
+        sort(matched_words.begin(), matched_words.end());
        
-        return {matched_words, documents_.at(document_id).status};
+        return {matched_words, document_columns_.GetStatus(ordinal)};
     }; 
     
     
     
     tuple<vector<string_view>, DocumentStatus> MatchDocument(const execution::parallel_policy&, const string_view raw_query, int document_id) const{
         
-        if (documents_.count(document_id) == 0) {
+        const auto ordinal_it = document_ordinals_.find(document_id);
+        if (ordinal_it == document_ordinals_.end()) {
             throw std::out_of_range("Invalid id");
         }
+        const uint32_t ordinal = ordinal_it->second;
     
         auto query = ParseQuery(false, raw_query);
         
-        auto word_ =[&](const string_view word) {  
-           const auto pos = word_to_document_freqs_.find(word);
-           return pos != word_to_document_freqs_.end() && pos->second.count(document_id);
+        auto word_ =[&](const TermId term_id) {  
+           return word_to_document_freqs_[term_id].Contains(ordinal);
     };
         
     if(any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), word_)){
-        return {vector<string_view> {}, documents_.at(document_id).status};
+        return {vector<string_view> {}, document_columns_.GetStatus(ordinal)};
     }
         
-    vector<string_view> matched_words(query.plus_words.size());
+    vector<TermId> matched_terms(query.plus_words.size());
     auto it = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(),
-                  matched_words.begin(), [&](const string_view word) {
-                      return word_(word);
+                  matched_terms.begin(), [&](const TermId term_id) {
+                      return word_(term_id);
                   });
     
-    sort(execution::par ,matched_words.begin(), it);
-    auto it2 = unique(execution::par ,matched_words.begin(), it);
-    matched_words.erase(it2, matched_words.end());
+    sort(execution::par ,matched_terms.begin(), it);
+    auto it2 = unique(execution::par ,matched_terms.begin(), it);
+    
+    vector<string_view> matched_words(it2 - matched_terms.begin());
+    transform(matched_terms.begin(), it2, matched_words.begin(), [this](const TermId term_id) {
+        return terms_.GetWord(term_id);
+    });
+    sort(matched_words.begin(), matched_words.end());
         
-   return {matched_words, documents_.at(document_id).status};   
+   return {matched_words, document_columns_.GetStatus(ordinal)};   
+    }
+
+    // Слова запроса проверяются потоками пула
+    tuple<vector<string_view>, DocumentStatus> MatchDocument(const ThreadPoolPolicy& policy, const string_view raw_query, int document_id) const{
+        const auto ordinal_it = document_ordinals_.find(document_id);
+        if (ordinal_it == document_ordinals_.end()) {
+            throw std::out_of_range("Invalid id");
+        }
+        const uint32_t ordinal = ordinal_it->second;
+
+        const auto query = ParseQuery(true, raw_query);
+        vector<TermId> terms = query.minus_words;
+        terms.insert(terms.end(), query.plus_words.begin(), query.plus_words.end());
+        vector<char> matched(terms.size());
+        policy.GetPool().ParallelFor(terms.size(), [&](size_t i) {
+            matched[i] = word_to_document_freqs_[terms[i]].Contains(ordinal);
+        });
+
+        const size_t minus_count = query.minus_words.size();
+        if (any_of(matched.begin(), matched.begin() + minus_count, [](char is_matched) { return is_matched; })) {
+            return {vector<string_view> {}, document_columns_.GetStatus(ordinal)};
+        }
+        vector<string_view> matched_words;
+        for (size_t i = minus_count; i < terms.size(); ++i) {
+            if (matched[i]) {
+                matched_words.push_back(terms_.GetWord(terms[i]));
+            }
+        }
+        sort(matched_words.begin(), matched_words.end());
+        return {matched_words, document_columns_.GetStatus(ordinal)};
     }
                  
 
 private:
-    struct DocumentData {
-        int rating;
-        string text;
-        DocumentStatus status;
-    };
     const set<string, less<>> stop_words_;
-    map<int, DocumentData> documents_;
+    TermDictionary terms_;
+    bool compress_postings_ = false;
+    // число документов с данным словом и кэш IDF, который сбрасывается сменой эпохи
+    vector<uint32_t> term_document_counts_;
+    // наибольшая TF слова по всем документам: верхняя оценка его вклада в релевантность.
+    // После удаления документов оценка может остаться завышенной, но не заниженной
+    vector<double> term_max_frequencies_;
+    IdfCache idf_cache_;
+    uint64_t index_epoch_ = 1;
+    // документы лежат по плотным внутренним номерам в порядке добавления
+    DocumentColumns document_columns_;
+    // номера документов каждого статуса
+    array<RoaringBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    TextArena document_texts_;
+    unordered_map<int, uint32_t> document_ordinals_;
+    // номера удалённых документов, вхождения которых ещё лежат в списках
+    OrdinalBitset deleted_ordinals_;
+    double compaction_threshold_ = 1.0;
+    // снимок, из которого открыт индекс; держит отображение живым
+    shared_ptr<const MappedFile> snapshot_file_;
+    QueryResultCache result_cache_;
+    PostingCache posting_cache_;
+    shared_ptr<const TermStatistics> term_statistics_;
+
+    // Одно плюс-слово запроса или пара соседних, объединённый список которых взят из кэша
+    struct PlusTermGroup {
+        TermId first;
+        TermId second = NO_TERM;
+        shared_ptr<const CachedPostings> pair;
+    };
+
+    // Часть пакета документов, разобранная одним потоком. Слова документов записаны
+    // номерами в словаре части, пока словарь не сопоставлен с общим
+    struct DocumentBatchChunk {
+        size_t begin = 0;
+        size_t end = 0;
+        unordered_map<string_view, TermId> local_ids;
+        vector<string_view> local_words;
+        // номер в общем словаре для каждого слова части
+        vector<TermId> global_ids;
+        vector<vector<TermCount>> document_terms;
+        vector<double> inv_word_counts;
+        // ошибка разбора текста документа, если была
+        vector<exception_ptr> errors;
+    };
+
+    // Вхождения пакета, сгруппированные по словам в порядке номеров документов
+    struct DocumentBatchPostings {
+        vector<TermId> term_ids;
+        vector<size_t> offsets;
+        vector<uint32_t> ordinals;
+        vector<uint32_t> term_counts;
+        vector<double> term_frequencies;
+    };
+
+    void ParseDocumentBatchChunk(const vector<const NewDocument*>& documents, DocumentBatchChunk& chunk) const;
+
+    // Бросает исключение AddDocument для первого неверного документа пакета
+    void ValidateDocumentBatch(const vector<const NewDocument*>& documents, const vector<DocumentBatchChunk>& chunks) const;
+
+    // Заводит слова частей в общем словаре в порядке первого появления, как их завёл бы AddDocument
+    void InternDocumentBatchTerms(vector<DocumentBatchChunk>& chunks);
+
+    // Переводит слова документов части на общие номера и сортирует их
+    static void TranslateDocumentBatchChunk(DocumentBatchChunk& chunk);
+
+    // Дописывает документы в столбцы, тексты и прямой индекс и возвращает их вхождения по словам
+    DocumentBatchPostings AppendDocumentBatch(const vector<const NewDocument*>& documents, const vector<DocumentBatchChunk>& chunks);
+
+    void InsertDocumentBatchPostings(const DocumentBatchPostings& postings, size_t term_index);
 
     bool IsStopWord(const string_view word) const;
 
@@ -191,48 +491,401 @@ private:
 
     static int ComputeAverageRating(const vector<int>& ratings);
 
-    const map<string_view, double>& GetWordFrequencies(int document_id) const;
+    // Помечает документ удалённым после того, как число документов с его словами уменьшено
+    void MarkDeleted(unordered_map<int, uint32_t>::const_iterator ordinal_it);
+
+    map<string_view, double> GetWordFrequencies(int document_id) const;
 
     QueryWord ParseQueryWord(const string_view text) const;
     
     Query ParseQuery(bool flag, const string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const string_view word) const;
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    // Суммарная длина списков вхождений слов: верхняя оценка числа кандидатов
+    size_t CountPostings(const vector<TermId>& term_ids) const;
+
+    static string MakeResultCacheKey(const Query& query, DocumentStatus status, size_t result_count);
+
+    // Результат compute() через кэш, если запрос фильтрует по статусу и кэш включён
+    template <typename DocumentPredicate, typename Compute>
+    vector<Document> FindTopDocumentsCached(const Query& query, const DocumentPredicate& document_predicate, const QueryOptions& options,
+                                            Compute compute) const;
+
+    // Разбивает отсортированные плюс-слова на группы по одному слову. Слева направо каждая
+    // пара соседних слов предлагается кэшу; пара из кэша становится одной группой,
+    // и её слова обходятся одним объединённым списком. Каждое предложение учитывается
+    // при допуске пары в кэш, так что частые пары из любого места запроса попадают в него
+    vector<PlusTermGroup> GroupPlusWords(const vector<TermId>& plus_words) const;
+
+    // Документы с минус-словами запроса. Множество взято из пула потока и занято, пока жива Lease.
+    // Перед каждым блоком вхождений проверяет отмену
+    ThreadLocalPool<OrdinalBitset>::Lease CollectExclusions(const vector<TermId>& minus_words, const CancellationToken& cancellation) const;
 
     template <typename DocumentPredicate, typename ExecutionPolicy>
-    vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate) const;
-};
+    vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, const CancellationToken& cancellation) const;
 
     template <typename DocumentPredicate>
-    vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-        map<int, double> document_to_relevance;
-      
-        for (auto word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+    bool MatchesPredicate(uint32_t ordinal, const DocumentPredicate& document_predicate) const;
+
+    // Лучшие документы с номерами из [begin, end)
+    template <typename DocumentPredicate>
+    vector<Document> FindTopDocumentsMaxScore(const Query& query, const OrdinalBitset& exclusions, DocumentPredicate document_predicate, size_t result_count,
+                                              const CancellationToken& cancellation, uint32_t begin = 0, uint32_t end = PostingList::Cursor::END) const;
+
+    template <typename DocumentPredicate>
+    vector<Document> FindAllDocumentsInRange(const Query& query, const vector<PlusTermGroup>& plus_groups, const OrdinalBitset& exclusions,
+                                             DocumentPredicate document_predicate, const CancellationToken& cancellation, uint32_t begin, uint32_t end) const;
+
+    // Вызывает function(ordinal, score) с вкладом слова группы в балл документа. У пары
+    // вклады двух слов начисляются по очереди, в том же порядке, что и при обходе по одному слову
+    template <typename DocumentPredicate, typename Function>
+    void ForEachGroupScore(const PlusTermGroup& group, const OrdinalBitset& exclusions, const DocumentPredicate& document_predicate,
+                           const CancellationToken& cancellation, Function function,
+                           uint32_t begin = 0, uint32_t end = PostingList::Cursor::END) const;
+
+    // Вызывает function(position) для номеров блока, которые проходят предикат
+    template <typename DocumentPredicate, typename Function>
+    void ForEachMatchingInBlock(const uint32_t* ordinals, size_t count, const DocumentPredicate& document_predicate, Function function) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    vector<Document> FindTopDocumentsByRanges(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, const QueryOptions& options) const;
+
+    // Вызывает function(ordinal, term_count) для вхождений с номерами из [begin, end), которые не исключены и проходят предикат
+    template <typename DocumentPredicate, typename Function>
+    // Перед каждым блоком проверяет отмену
+    void ForEachMatchingPosting(const PostingList& postings, const OrdinalBitset& exclusions, const DocumentPredicate& document_predicate,
+                                const CancellationToken& cancellation, Function function,
+                                uint32_t begin = 0, uint32_t end = PostingList::Cursor::END) const;
+};
+
+template <typename DocumentPredicate, typename Function>
+void SearchServer::ForEachMatchingInBlock(const uint32_t* ordinals, size_t count, const DocumentPredicate& document_predicate, Function function) const {
+    if constexpr (is_same_v<DocumentPredicate, StatusPredicate>) {
+        uint32_t selected[POSTING_BLOCK_SIZE];
+        const size_t selected_count = status_documents_[static_cast<size_t>(document_predicate.status)].Select(ordinals, count, selected);
+        for (size_t i = 0; i < selected_count; ++i) {
+            function(static_cast<size_t>(selected[i]));
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t ordinal = ordinals[i];
+            // в множествах статусов удалённых документов уже нет
+            if (!deleted_ordinals_.Test(ordinal)
+                && document_predicate(document_columns_.GetId(ordinal), document_columns_.GetStatus(ordinal), document_columns_.GetRating(ordinal))) {
+                function(i);
+            }
+        }
+    }
+}
+
+template <typename DocumentPredicate, typename Function>
+void SearchServer::ForEachGroupScore(const PlusTermGroup& group, const OrdinalBitset& exclusions, const DocumentPredicate& document_predicate,
+                                     const CancellationToken& cancellation, Function function, uint32_t begin, uint32_t end) const {
+    const double first_inverse_document_freq = ComputeWordInverseDocumentFreq(group.first);
+    if (!group.pair) {
+        ForEachMatchingPosting(word_to_document_freqs_[group.first], exclusions, document_predicate, cancellation, [&](uint32_t ordinal, uint32_t term_count) {
+            function(ordinal, term_count * document_columns_.GetInvWordCount(ordinal) * first_inverse_document_freq);
+        }, begin, end);
+        return;
+    }
+    if constexpr (is_same_v<DocumentPredicate, StatusPredicate>) {
+        if (static_cast<size_t>(document_predicate.status) >= DOCUMENT_STATUS_COUNT) {
+            return;
+        }
+    }
+
+    const double second_inverse_document_freq = ComputeWordInverseDocumentFreq(group.second);
+    const CachedPostings& pair = *group.pair;
+    const size_t first = lower_bound(pair.ordinals.begin(), pair.ordinals.end(), begin) - pair.ordinals.begin();
+    const size_t last = lower_bound(pair.ordinals.begin() + first, pair.ordinals.end(), end) - pair.ordinals.begin();
+    for (size_t block_begin = first; block_begin < last; block_begin += POSTING_BLOCK_SIZE) {
+        cancellation.ThrowIfCancelled();
+        const size_t block_end = min(last, block_begin + POSTING_BLOCK_SIZE);
+        uint32_t kept_ordinals[POSTING_BLOCK_SIZE];
+        uint32_t kept_positions[POSTING_BLOCK_SIZE];
+        size_t kept_count = 0;
+        for (size_t position = block_begin; position < block_end; ++position) {
+            kept_ordinals[kept_count] = pair.ordinals[position];
+            kept_positions[kept_count] = static_cast<uint32_t>(position);
+            kept_count += exclusions.IsClear() || !exclusions.Test(pair.ordinals[position]);
+        }
+        ForEachMatchingInBlock(kept_ordinals, kept_count, document_predicate, [&](size_t kept) {
+            const uint32_t position = kept_positions[kept];
+            const uint32_t ordinal = pair.ordinals[position];
+            const double inv_word_count = document_columns_.GetInvWordCount(ordinal);
+            // отсутствующее слово ничего не начисляет, как и в своём списке
+            if (pair.first_term_counts[position] != 0) {
+                function(ordinal, pair.first_term_counts[position] * inv_word_count * first_inverse_document_freq);
+            }
+            if (pair.second_term_counts[position] != 0) {
+                function(ordinal, pair.second_term_counts[position] * inv_word_count * second_inverse_document_freq);
+            }
+        });
+    }
+}
+
+template <typename DocumentPredicate, typename Function>
+void SearchServer::ForEachMatchingPosting(const PostingList& postings, const OrdinalBitset& exclusions, const DocumentPredicate& document_predicate,
+                                          const CancellationToken& cancellation, Function function,
+                                          uint32_t begin, uint32_t end) const {
+    if constexpr (is_same_v<DocumentPredicate, StatusPredicate>) {
+        if (static_cast<size_t>(document_predicate.status) >= DOCUMENT_STATUS_COUNT) {
+            return;
+        }
+    }
+    const auto filter_block = [&](const uint32_t* ordinals, const uint32_t* term_counts, size_t count) {
+        cancellation.ThrowIfCancelled();
+        ForEachMatchingInBlock(ordinals, count, document_predicate, [&](size_t position) {
+            function(ordinals[position], term_counts[position]);
+        });
+    };
+
+    if (exclusions.IsClear()) {
+        postings.ForEachBlockInRange(begin, end, filter_block);
+        return;
+    }
+    postings.ForEachBlockInRange(begin, end, [&](const uint32_t* ordinals, const uint32_t* term_counts, size_t count) {
+        // исключённые вхождения выбрасываются до предиката, без ветвлений
+        uint32_t kept_ordinals[POSTING_BLOCK_SIZE];
+        uint32_t kept_term_counts[POSTING_BLOCK_SIZE];
+        size_t kept_count = 0;
+        for (size_t i = 0; i < count; ++i) {
+            kept_ordinals[kept_count] = ordinals[i];
+            kept_term_counts[kept_count] = term_counts[i];
+            kept_count += !exclusions.Test(ordinals[i]);
+        }
+        filter_block(kept_ordinals, kept_term_counts, kept_count);
+    });
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::MatchesPredicate(uint32_t ordinal, const DocumentPredicate& document_predicate) const {
+    if (deleted_ordinals_.Test(ordinal)) {
+        return false;
+    }
+    if constexpr (is_same_v<DocumentPredicate, StatusPredicate>) {
+        return document_columns_.GetStatus(ordinal) == document_predicate.status;
+    } else {
+        return document_predicate(document_columns_.GetId(ordinal), document_columns_.GetStatus(ordinal), document_columns_.GetRating(ordinal));
+    }
+}
+
+// Плюс-слова упорядочены по верхней оценке вклада. Младшие слова, сумма оценок
+// которых ниже порога текущих лучших, не порождают кандидатов: их списки
+// проверяются только для документов из старших списков и только пока документ
+// ещё может пройти порог. Уточнённые оценки берутся по диапазонам списков,
+// и диапазоны, которые не могут дать порога, пропускаются целиком.
+// Вклады складываются в порядке слов запроса, поэтому релевантность
+// совпадает с полным подсчётом до бита
+template <typename DocumentPredicate>
+vector<Document> SearchServer::FindTopDocumentsMaxScore(const Query& query, const OrdinalBitset& exclusions, DocumentPredicate document_predicate, size_t result_count,
+                                                       const CancellationToken& cancellation, uint32_t begin, uint32_t end) const {
+    vector<Document> matched_documents;
+    if (result_count == 0) {
+        return matched_documents;
+    }
+
+    struct QueryTerm {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+    };
+    vector<QueryTerm> terms;
+    terms.reserve(query.plus_words.size());
+    for (const TermId term_id : query.plus_words) {
+        const PostingList& postings = word_to_document_freqs_[term_id];
+        if (postings.empty()) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+        terms.push_back({PostingList::Cursor(postings), inverse_document_freq, term_max_frequencies_[term_id] * inverse_document_freq});
+        terms.back().cursor.NextGEQ(begin);
+    }
+
+    vector<size_t> order(terms.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&terms](size_t lhs, size_t rhs) {
+        return terms[lhs].max_score < terms[rhs].max_score;
+    });
+    // bounds[k] — сумма верхних оценок слов order[0..k)
+    vector<double> bounds(terms.size() + 1, 0.0);
+    for (size_t k = 0; k < order.size(); ++k) {
+        bounds[k + 1] = bounds[k] + terms[order[k]].max_score;
+    }
+
+    // документ с релевантностью ниже порога проигрывает всем текущим лучшим
+    double threshold = -numeric_limits<double>::infinity();
+    priority_queue<double, vector<double>, greater<double>> top_relevances;
+    size_t essential_begin = 0;
+    vector<double> contributions(terms.size());
+    // block_bounds[k] — сумма оценок слов order[0..k) по диапазонам, в которые попал кандидат
+    vector<double> block_bounds(terms.size() + 1, 0.0);
+    uint32_t block_end = 0;
+    bool has_block_bounds = false;
+
+    for (size_t step = 0;; ++step) {
+        if (step % POSTING_BLOCK_SIZE == 0) {
+            cancellation.ThrowIfCancelled();
+        }
+        uint32_t ordinal = PostingList::Cursor::END;
+        for (size_t k = essential_begin; k < order.size(); ++k) {
+            ordinal = min(ordinal, terms[order[k]].cursor.GetOrdinal());
+        }
+        if (ordinal >= end) {
+            break;
+        }
+
+        if (top_relevances.size() == result_count) {
+            // оценки одинаковы для всех документов до конца самого короткого
+            // из диапазонов, куда попал кандидат, поэтому пересчитываются только за его пределами
+            if (!has_block_bounds || ordinal > block_end) {
+                has_block_bounds = true;
+                block_end = PostingList::Cursor::END;
+                for (size_t k = 0; k < order.size(); ++k) {
+                    PostingList::Cursor& cursor = terms[order[k]].cursor;
+                    cursor.ShallowNextGEQ(ordinal);
+                    block_bounds[k + 1] = block_bounds[k] + cursor.GetBlockMaxFrequency() * terms[order[k]].inverse_document_freq;
+                    block_end = min(block_end, cursor.GetBlockLastOrdinal());
+                }
+            }
+            if (block_bounds.back() < threshold) {
+                if (block_end >= end - 1) {
+                    break;
+                }
+                for (size_t k = essential_begin; k < order.size(); ++k) {
+                    terms[order[k]].cursor.NextGEQ(block_end + 1);
+                }
                 continue;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        }
+
+        if (exclusions.Test(ordinal) || !MatchesPredicate(ordinal, document_predicate)) {
+            for (size_t k = essential_begin; k < order.size(); ++k) {
+                if (terms[order[k]].cursor.GetOrdinal() == ordinal) {
+                    terms[order[k]].cursor.Next();
                 }
             }
+            continue;
         }
-        
-        for (auto word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+
+        fill(contributions.begin(), contributions.end(), 0.0);
+        double score = 0.0;
+        for (size_t k = essential_begin; k < order.size(); ++k) {
+            QueryTerm& term = terms[order[k]];
+            if (term.cursor.GetOrdinal() == ordinal) {
+                const double contribution = term.cursor.GetTermCount() * document_columns_.GetInvWordCount(ordinal) * term.inverse_document_freq;
+                contributions[order[k]] = contribution;
+                score += contribution;
+                term.cursor.Next();
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+        }
+        // пока порога нет, block_bounds не считаются, но и отсечений не бывает
+        if (score + block_bounds[essential_begin] < threshold) {
+            continue;
+        }
+
+        bool pruned = false;
+        for (size_t k = essential_begin; k-- > 0;) {
+            if (score + block_bounds[k + 1] < threshold) {
+                pruned = true;
+                break;
+            }
+            QueryTerm& term = terms[order[k]];
+            term.cursor.NextGEQ(ordinal);
+            if (term.cursor.GetOrdinal() == ordinal) {
+                const double contribution = term.cursor.GetTermCount() * document_columns_.GetInvWordCount(ordinal) * term.inverse_document_freq;
+                contributions[order[k]] = contribution;
+                score += contribution;
             }
         }
-        vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        if (pruned) {
+            continue;
         }
-        return matched_documents;
+
+        const double relevance = accumulate(contributions.begin(), contributions.end(), 0.0);
+        if (relevance < threshold) {
+            continue;
+        }
+        matched_documents.push_back({document_columns_.GetId(ordinal), relevance, document_columns_.GetRating(ordinal)});
+        top_relevances.push(relevance);
+        if (top_relevances.size() > result_count) {
+            top_relevances.pop();
+        }
+        if (top_relevances.size() == result_count) {
+            threshold = top_relevances.top() - EPS;
+            while (essential_begin < order.size() && bounds[essential_begin + 1] < threshold) {
+                ++essential_begin;
+            }
+        }
+    }
+
+    SelectTop(matched_documents, result_count, IsMoreRelevant);
+    return matched_documents;
+}
+
+    template <typename DocumentPredicate>
+    vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
+        return FindAllDocumentsInRange(query, GroupPlusWords(query.plus_words), *CollectExclusions(query.minus_words, CancellationToken{}), document_predicate, CancellationToken{}, 0,
+                                       PostingList::Cursor::END);
+}
+
+template <typename DocumentPredicate>
+vector<Document> SearchServer::FindAllDocumentsInRange(const Query& query, const vector<PlusTermGroup>& plus_groups, const OrdinalBitset& exclusions,
+                                                       DocumentPredicate document_predicate, const CancellationToken& cancellation, uint32_t begin, uint32_t end) const {
+    const auto document_to_relevance = ThreadLocalPool<ScoreAccumulator>::Acquire();
+    document_to_relevance->Reset(document_columns_.size(), CountPostings(query.plus_words));
+
+    for (const PlusTermGroup& group : plus_groups) {
+        ForEachGroupScore(group, exclusions, document_predicate, cancellation, [&](uint32_t ordinal, double score) {
+            document_to_relevance->Add(ordinal, score);
+        }, begin, end);
+    }
+    vector<Document> matched_documents;
+    document_to_relevance->ForEach([&](uint32_t ordinal, double relevance) {
+        matched_documents.push_back({document_columns_.GetId(ordinal), relevance, document_columns_.GetRating(ordinal)});
+    });
+    return matched_documents;
+}
+
+// Диапазоны не пересекаются, поэтому потоки не делят ни накопителей, ни результатов.
+// В каждом диапазоне остаются только его лучшие: общие лучшие всегда среди них
+template <typename DocumentPredicate, typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocumentsByRanges(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, const QueryOptions& options) const {
+    const uint64_t document_count = document_columns_.size();
+    size_t shard_count = options.shard_count != 0 ? options.shard_count : GetParallelism(policy);
+    shard_count = static_cast<size_t>(max<uint64_t>(min<uint64_t>(shard_count, document_count), 1));
+
+    // множество исключений занято запросом до выхода из функции, рабочие только читают его
+    const auto exclusions = CollectExclusions(query.minus_words, options.cancellation);
+    const vector<PlusTermGroup> plus_groups = GroupPlusWords(query.plus_words);
+    vector<vector<Document>> shard_documents(shard_count);
+    vector<size_t> shards(shard_count);
+    iota(shards.begin(), shards.end(), 0);
+    ParallelForEach(policy, shards.begin(), shards.end(), [&](size_t shard) {
+        const uint32_t begin = static_cast<uint32_t>(document_count * shard / shard_count);
+        // последний диапазон открыт справа: номера документов, добавленных во время поиска, в него не попадут
+        const uint32_t end = shard + 1 == shard_count ? PostingList::Cursor::END : static_cast<uint32_t>(document_count * (shard + 1) / shard_count);
+        if (options.scoring_mode == ScoringMode::MAX_SCORE) {
+            shard_documents[shard] = FindTopDocumentsMaxScore(query, *exclusions, document_predicate, options.max_result_count, options.cancellation, begin, end);
+        } else {
+            shard_documents[shard] = FindAllDocumentsInRange(query, plus_groups, *exclusions, document_predicate, options.cancellation, begin, end);
+            SelectTop(shard_documents[shard], options.max_result_count, IsMoreRelevant);
+        }
+    });
+
+    // max_result_count может быть любым, вплоть до SIZE_MAX, поэтому места берётся по числу найденных
+    size_t matched_count = 0;
+    for (const auto& documents : shard_documents) {
+        matched_count += documents.size();
+    }
+    vector<Document> matched_documents;
+    matched_documents.reserve(matched_count);
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    SelectTop(matched_documents, options.max_result_count, IsMoreRelevant);
+    return matched_documents;
 }
 
 
@@ -249,30 +902,225 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 
 template <typename DocumentPredicate>
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentPredicate document_predicate) const {
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentPredicate document_predicate, const QueryOptions& options) const {
 
     const auto query = ParseQuery(true,raw_query);
-    
-    auto matched_documents = FindAllDocuments(query, document_predicate);
-    
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (abs(lhs.relevance - rhs.relevance) < EPS) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+    return FindTopDocumentsCached(query, document_predicate, options, [&] {
+        if (options.scoring_mode == ScoringMode::MAX_SCORE) {
+            return FindTopDocumentsMaxScore(query, *CollectExclusions(query.minus_words, options.cancellation), document_predicate, options.max_result_count, options.cancellation);
         }
+
+        auto matched_documents = FindAllDocumentsInRange(query, GroupPlusWords(query.plus_words), *CollectExclusions(query.minus_words, options.cancellation), document_predicate,
+                                                         options.cancellation, 0, PostingList::Cursor::END);
+
+        SelectTop(matched_documents, options.max_result_count, IsMoreRelevant);
+        return matched_documents;
     });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate, typename Compute>
+vector<Document> SearchServer::FindTopDocumentsCached(const Query& query, const DocumentPredicate& document_predicate, const QueryOptions& options,
+                                                      Compute compute) const {
+    // у произвольного предиката нет ключа
+    if constexpr (is_same_v<DocumentPredicate, StatusPredicate>) {
+        if (result_cache_.IsEnabled()) {
+            string key = MakeResultCacheKey(query, document_predicate.status, options.max_result_count);
+            vector<Document> documents;
+            if (result_cache_.Find(key, index_epoch_, documents)) {
+                return documents;
+            }
+            documents = compute();
+            result_cache_.Insert(move(key), index_epoch_, documents);
+            return documents;
+        }
     }
-    return matched_documents;
+    return compute();
+}
+
+template <typename DocumentPredicate>
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(raw_query, document_predicate, QueryOptions{});
+}
+
+// Запросы пакета делятся на группы по BATCH_QUERY_COUNT. В группе слова всех запросов
+// сортируются, и список каждого слова читается один раз: вклад вхождения
+// начисляется всем запросам группы с этим плюс-словом, а документ исключается
+// из запросов с этим минус-словом. Слова обходятся по возрастанию, как и в
+// отдельном запросе, поэтому вклады складываются в том же порядке
+template <typename ExecutionPolicy, typename DocumentPredicate>
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const vector<string>& raw_queries, DocumentPredicate document_predicate,
+                                                             const QueryOptions& options) const {
+    vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(true, raw_query));
+    }
+
+    struct TermQuery {
+        TermId term_id;
+        bool is_minus;
+        uint8_t query;
+
+        bool operator<(const TermQuery& other) const {
+            return tie(term_id, is_minus, query) < tie(other.term_id, other.is_minus, other.query);
+        }
+    };
+
+    // запросы с одним и тем же самым длинным списком попадают в одну группу,
+    // и этот список читается один раз на всю группу
+    vector<size_t> order(queries.size());
+    iota(order.begin(), order.end(), 0);
+    vector<TermId> longest_terms(queries.size(), NO_TERM);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        size_t longest_size = 0;
+        for (const TermId term_id : queries[i].plus_words) {
+            if (word_to_document_freqs_[term_id].size() >= longest_size) {
+                longest_size = word_to_document_freqs_[term_id].size();
+                longest_terms[i] = term_id;
+            }
+        }
+    }
+    stable_sort(order.begin(), order.end(), [&longest_terms](size_t lhs, size_t rhs) {
+        return longest_terms[lhs] < longest_terms[rhs];
+    });
+
+    vector<vector<Document>> results(queries.size());
+    vector<size_t> group_begins;
+    for (size_t begin = 0; begin < queries.size(); begin += BATCH_QUERY_COUNT) {
+        group_begins.push_back(begin);
+    }
+    ParallelForEach(policy, group_begins.begin(), group_begins.end(), [&](size_t group_begin) {
+        const size_t group_size = min(BATCH_QUERY_COUNT, queries.size() - group_begin);
+        vector<TermQuery> term_queries;
+        for (size_t query = 0; query < group_size; ++query) {
+            for (const TermId term_id : queries[order[group_begin + query]].plus_words) {
+                term_queries.push_back({term_id, false, static_cast<uint8_t>(query)});
+            }
+            for (const TermId term_id : queries[order[group_begin + query]].minus_words) {
+                term_queries.push_back({term_id, true, static_cast<uint8_t>(query)});
+            }
+        }
+        sort(term_queries.begin(), term_queries.end());
+
+        // строки баллов читаются один раз на всю группу, поэтому кандидаты раскладываются
+        // по всем запросам сразу, в буферы потока, которые не выделяются заново
+        const auto candidates_lease = ThreadLocalPool<array<vector<Document>, BATCH_QUERY_COUNT>>::Acquire();
+        auto& candidates = *candidates_lease;
+        for (vector<Document>& query_candidates : candidates) {
+            query_candidates.clear();
+        }
+
+        // документы обходятся полосами, и каждая часть списка читается один раз. Вклады
+        // в балл документа приходят в том же порядке слов, что и без полос
+        const auto document_to_relevance = ThreadLocalPool<BatchScoreAccumulator>::Acquire();
+        const OrdinalBitset no_exclusions;
+        const size_t document_count = document_columns_.size();
+        for (size_t begin = 0; begin < document_count; begin += BATCH_TILE_DOCUMENT_COUNT) {
+            const uint32_t tile_begin = static_cast<uint32_t>(begin);
+            const uint32_t tile_end = static_cast<uint32_t>(min(begin + BATCH_TILE_DOCUMENT_COUNT, document_count));
+            document_to_relevance->Reset(tile_begin, tile_end - tile_begin);
+            for (auto it = term_queries.begin(); it != term_queries.end();) {
+                const TermId term_id = it->term_id;
+                const PostingList& postings = word_to_document_freqs_[term_id];
+                const auto minus_begin = find_if(it, term_queries.end(), [term_id](const TermQuery& term_query) {
+                    return term_query.term_id != term_id || term_query.is_minus;
+                });
+                const auto group_end = find_if(minus_begin, term_queries.end(), [term_id](const TermQuery& term_query) {
+                    return term_query.term_id != term_id;
+                });
+
+                if (it != minus_begin) {
+                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+                    ForEachMatchingPosting(postings, no_exclusions, document_predicate, options.cancellation, [&](uint32_t ordinal, uint32_t term_count) {
+                        const double term_frequency = term_count * document_columns_.GetInvWordCount(ordinal);
+                        for (auto target = it; target != minus_begin; ++target) {
+                            document_to_relevance->Add(ordinal, target->query, term_frequency * inverse_document_freq);
+                        }
+                    }, tile_begin, tile_end);
+                }
+                if (minus_begin != group_end) {
+                    postings.ForEachBlockInRange(tile_begin, tile_end, [&](const uint32_t* ordinals, const uint32_t*, size_t count) {
+                        options.cancellation.ThrowIfCancelled();
+                        for (size_t i = 0; i < count; ++i) {
+                            for (auto target = minus_begin; target != group_end; ++target) {
+                                document_to_relevance->Exclude(ordinals[i], target->query);
+                            }
+                        }
+                    });
+                }
+                it = group_end;
+            }
+
+            document_to_relevance->ForEach([&](size_t query, uint32_t ordinal, double relevance) {
+                candidates[query].push_back({document_columns_.GetId(ordinal), relevance, document_columns_.GetRating(ordinal)});
+            });
+        }
+        for (size_t query = 0; query < group_size; ++query) {
+            SelectTop(candidates[query], options.max_result_count, IsMoreRelevant);
+            results[order[group_begin + query]] = candidates[query];
+        }
+    });
+    return results;
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentRange& documents) {
+    vector<const NewDocument*> batch;
+    for (const NewDocument& document : documents) {
+        batch.push_back(&document);
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    // частей больше, чем потоков, чтобы длинные тексты не задерживали одну часть
+    const size_t chunk_count = min(batch.size(), GetParallelism(policy) * 4);
+    vector<DocumentBatchChunk> chunks(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = batch.size() * i / chunk_count;
+        chunks[i].end = batch.size() * (i + 1) / chunk_count;
+    }
+    ParallelForEach(policy, chunks.begin(), chunks.end(), [this, &batch](DocumentBatchChunk& chunk) {
+        ParseDocumentBatchChunk(batch, chunk);
+    });
+    ValidateDocumentBatch(batch, chunks);
+
+    InternDocumentBatchTerms(chunks);
+    ParallelForEach(policy, chunks.begin(), chunks.end(), [](DocumentBatchChunk& chunk) {
+        TranslateDocumentBatchChunk(chunk);
+    });
+    const DocumentBatchPostings postings = AppendDocumentBatch(batch, chunks);
+    vector<size_t> term_indexes(postings.term_ids.size());
+    iota(term_indexes.begin(), term_indexes.end(), 0);
+    // у каждого слова свой список вхождений, поэтому слова пополняются независимо
+    ParallelForEach(policy, term_indexes.begin(), term_indexes.end(), [this, &postings](size_t term_index) {
+        InsertDocumentBatchPostings(postings, term_index);
+    });
+    ++index_epoch_;
+}
+
+template <typename DocumentPredicate>
+future<vector<Document>> SearchServer::FindTopDocumentsAsync(ThreadPool& pool, string raw_query, DocumentPredicate document_predicate, const QueryOptions& options) const {
+    // packaged_task переносит исключение, в том числе QueryCancelled, в future
+    auto task = make_shared<packaged_task<vector<Document>()>>([this, raw_query = move(raw_query), document_predicate, options] {
+        options.cancellation.ThrowIfCancelled();
+        return FindTopDocuments(raw_query, document_predicate, options);
+    });
+    future<vector<Document>> result = task->get_future();
+    pool.Submit([task] {
+        (*task)();
+    });
+    return result;
+}
+
+template <typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentStatus status, const QueryOptions& options) const {
+        return FindTopDocuments(policy, raw_query, StatusPredicate{status}, options);
 }
 
 template <typename ExecutionPolicy>
 vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+        return FindTopDocuments(policy, raw_query, StatusPredicate{status});
 }
 
 template <typename ExecutionPolicy>
@@ -282,71 +1130,66 @@ vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
 vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, QueryOptions{});
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const string_view raw_query, DocumentPredicate document_predicate, const QueryOptions& options) const {
 
     //int t1 = clock();
     const auto query = ParseQuery(true,raw_query);
     // int t2 = clock();
     //cout << "PQ " << (double)(t2-t1)/CLOCKS_PER_SEC << endl;
-    
-    //int t1 = clock();
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    //int t2 = clock();
-    //cout << "FAD " << (double)(t2-t1)/CLOCKS_PER_SEC << endl;
-    
-    sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (abs(lhs.relevance - rhs.relevance) < EPS) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+    return FindTopDocumentsCached(query, document_predicate, options, [&] {
+        if (options.parallel_mode == ParallelMode::BY_DOCUMENT_RANGES) {
+            return FindTopDocumentsByRanges(policy, query, document_predicate, options);
+        }
+        if (options.scoring_mode == ScoringMode::MAX_SCORE) {
+            // обход по документам последовательный
+            return FindTopDocumentsMaxScore(query, *CollectExclusions(query.minus_words, options.cancellation), document_predicate, options.max_result_count, options.cancellation);
         }
+
+        //int t1 = clock();
+        auto matched_documents = FindAllDocuments(policy, query, document_predicate, options.cancellation);
+        //int t2 = clock();
+        //cout << "FAD " << (double)(t2-t1)/CLOCKS_PER_SEC << endl;
+
+        SelectTop(policy, matched_documents, options.max_result_count, IsMoreRelevant);
+
+        return matched_documents;
     });
-    
-    
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    
-    return matched_documents;
 }
 
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
-    vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate) const {
-        ConcurrentMap<int, double> document_to_relevance(150);
-        //map<int, double> document_to_relevance;
-        
-        for_each(policy, query.plus_words.begin(), query.plus_words.end(),[&](auto word){
-            if (word_to_document_freqs_.count(word) != 0) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                        /*
-                        
-                        document_to_relevance[document_id] = document_to_relevance[document_id]+ term_freq * inverse_document_freq;
-                        */
-
-                    }
-                }
-            }
+    vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, const CancellationToken& cancellation) const {
+        // слова разбираются параллельно, каждое в свой буфер, а в общий накопитель
+        // баллы складываются одним потоком в порядке слов, как и в последовательной версии
+        const auto exclusions = CollectExclusions(query.minus_words, cancellation);
+        const vector<PlusTermGroup> plus_groups = GroupPlusWords(query.plus_words);
+        vector<vector<pair<uint32_t, double>>> term_scores(plus_groups.size());
+        ParallelForEach(policy, plus_groups.begin(), plus_groups.end(),[&](const PlusTermGroup& group){
+            auto& scores = term_scores[&group - plus_groups.data()];
+            scores.reserve(group.pair ? group.pair->ordinals.size() : word_to_document_freqs_[group.first].size());
+
+            ForEachGroupScore(group, *exclusions, document_predicate, cancellation, [&](uint32_t ordinal, double score) {
+                scores.emplace_back(ordinal, score);
+            });
         });
-        
-        for_each(policy, query.minus_words.begin(), query.minus_words.end(),[&](auto word){
-            if (word_to_document_freqs_.count(word) != 0) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
-                }
+
+        const auto document_to_relevance = ThreadLocalPool<ScoreAccumulator>::Acquire();
+        document_to_relevance->Reset(document_columns_.size(), CountPostings(query.plus_words));
+        for (const auto& scores : term_scores) {
+            cancellation.ThrowIfCancelled();
+            for (const auto& [ordinal, score] : scores) {
+                document_to_relevance->Add(ordinal, score);
             }
-        });
+        }
         
         vector<Document> matched_documents{};
-        map<int, double> document_to_relevance_ = document_to_relevance.BuildOrdinaryMap();
-        for (const auto [document_id, relevance] : document_to_relevance_) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-        }
+        document_to_relevance->ForEach([&](uint32_t ordinal, double relevance) {
+            matched_documents.push_back({document_columns_.GetId(ordinal), relevance, document_columns_.GetRating(ordinal)});
+        });
         return matched_documents;
 }
 
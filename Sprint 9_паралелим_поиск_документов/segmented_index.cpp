@@ -0,0 +1,199 @@
+#include "segmented_index.h"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+SegmentedIndex::SegmentedIndex(const string& stop_words_text, const SegmentedIndexOptions& options)
+    : stop_words_text_(stop_words_text)
+    , options_(options) {
+    if (options_.flush_document_count == 0 || options_.merge_factor < 2) {
+        throw invalid_argument("Invalid segmented index options"s);
+    }
+    mutable_segment_ = MakeSegment(false);
+    RebuildStatistics();
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    if (merge_) {
+        merge_->result.wait();
+    }
+}
+
+unique_ptr<SearchServer> SegmentedIndex::MakeSegment(bool compress) const {
+    auto server = make_unique<SearchServer>(stop_words_text_);
+    server->SetPostingCompression(compress);
+    return server;
+}
+
+void SegmentedIndex::RebuildStatistics() {
+    vector<const SearchServer*> servers;
+    ForEachSegment([&servers](const SearchServer& server) {
+        servers.push_back(&server);
+    });
+    statistics_ = make_shared<TermStatistics>(move(servers));
+    SetSegmentStatistics();
+    statistics_stale_.store(false, memory_order_release);
+}
+
+void SegmentedIndex::SetSegmentStatistics() const {
+    for (const Segment& segment : segments_) {
+        segment.server->SetTermStatistics(statistics_);
+    }
+    mutable_segment_->SetTermStatistics(statistics_);
+}
+
+void SegmentedIndex::PublishStaleStatistics() const {
+    if (!statistics_stale_.load(memory_order_acquire)) {
+        return;
+    }
+    lock_guard<mutex> guard(statistics_mutex_);
+    if (statistics_stale_.load(memory_order_relaxed)) {
+        SetSegmentStatistics();
+        statistics_stale_.store(false, memory_order_release);
+    }
+}
+
+void SegmentedIndex::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    InstallMerge(false);
+    if ((document_id < 0) || (document_segments_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    mutable_segment_->AddDocument(document_id, document, status, ratings);
+    document_segments_.emplace(document_id, mutable_segment_.get());
+    // сегменты получат изменённую статистику перед следующим поиском
+    statistics_stale_.store(true, memory_order_release);
+
+    if (static_cast<size_t>(mutable_segment_->GetDocumentCount()) >= options_.flush_document_count) {
+        Flush();
+    }
+}
+
+void SegmentedIndex::RemoveDocument(int document_id) {
+    InstallMerge(false);
+    const auto it = document_segments_.find(document_id);
+    if (it == document_segments_.end()) {
+        return;
+    }
+    SearchServer* const server = it->second;
+    server->RemoveDocument(document_id);
+    document_segments_.erase(it);
+    if (merge_) {
+        for (size_t i = merge_->first_segment; i < merge_->first_segment + merge_->segment_count; ++i) {
+            if (segments_[i].server.get() == server) {
+                merge_->removed_document_ids.push_back(document_id);
+                break;
+            }
+        }
+    }
+    // сегменты получат изменённую статистику перед следующим поиском
+    statistics_stale_.store(true, memory_order_release);
+}
+
+tuple<vector<string_view>, DocumentStatus> SegmentedIndex::MatchDocument(string_view raw_query, int document_id) const {
+    const auto it = document_segments_.find(document_id);
+    if (it == document_segments_.end()) {
+        throw out_of_range("Invalid id"s);
+    }
+    return it->second->MatchDocument(raw_query, document_id);
+}
+
+void SegmentedIndex::Flush() {
+    InstallMerge(false);
+    if (mutable_segment_->GetDocumentCount() == 0) {
+        return;
+    }
+    if (options_.compress_segments) {
+        mutable_segment_->SetPostingCompression(true);
+    }
+    segments_.push_back({move(mutable_segment_), 0});
+    mutable_segment_ = MakeSegment(false);
+    RebuildStatistics();
+    StartMerge();
+}
+
+void SegmentedIndex::WaitForMerges() {
+    while (merge_) {
+        InstallMerge(true);
+    }
+}
+
+void SegmentedIndex::InstallMerge(bool wait) {
+    if (!merge_ || (!wait && merge_->result.wait_for(chrono::seconds(0)) != future_status::ready)) {
+        return;
+    }
+    const unique_ptr<Merge> merge = move(merge_);
+    unique_ptr<SearchServer> merged = merge->result.get();
+    for (const int document_id : merge->removed_document_ids) {
+        merged->RemoveDocument(document_id);
+    }
+    for (const int document_id : *merged) {
+        document_segments_[document_id] = merged.get();
+    }
+
+    const auto first = segments_.begin() + merge->first_segment;
+    const size_t level = first->level + 1;
+    segments_.erase(first, first + merge->segment_count);
+    if (merged->GetDocumentCount() > 0) {
+        segments_.insert(segments_.begin() + merge->first_segment, Segment{move(merged), level});
+    }
+    RebuildStatistics();
+    StartMerge();
+}
+
+void SegmentedIndex::StartMerge() {
+    if (merge_) {
+        return;
+    }
+    // уровни не возрастают от старых сегментов к новым; сливается самый низкий
+    // уровень, у которого набралось merge_factor соседних сегментов
+    size_t first_segment = segments_.size();
+    for (size_t end = segments_.size(); end > 0;) {
+        size_t begin = end - 1;
+        while (begin > 0 && segments_[begin - 1].level == segments_[end - 1].level) {
+            --begin;
+        }
+        if (end - begin >= options_.merge_factor) {
+            first_segment = begin;
+            break;
+        }
+        end = begin;
+    }
+    if (first_segment == segments_.size()) {
+        return;
+    }
+
+    auto input = make_shared<MergeInput>();
+    vector<size_t> text_offsets;
+    for (size_t i = first_segment; i < first_segment + options_.merge_factor; ++i) {
+        for (NewDocument& document : segments_[i].server->GetDocuments()) {
+            text_offsets.push_back(input->texts.size());
+            input->texts.append(document.text);
+            input->documents.push_back(move(document));
+        }
+    }
+    // строка текстов больше не растёт, и на неё можно ссылаться
+    for (size_t i = 0; i < input->documents.size(); ++i) {
+        input->documents[i].text = string_view(input->texts).substr(text_offsets[i], input->documents[i].text.size());
+    }
+
+    merge_ = make_unique<Merge>();
+    merge_->first_segment = first_segment;
+    merge_->segment_count = options_.merge_factor;
+    // packaged_task переносит в future и исключение, если оно будет
+    auto task = make_shared<packaged_task<unique_ptr<SearchServer>()>>([this, input] {
+        unique_ptr<SearchServer> server = MakeSegment(options_.compress_segments);
+        server->AddDocuments(input->documents);
+        return server;
+    });
+    merge_->result = task->get_future();
+    if (options_.background_merge) {
+        ThreadPool::GetShared().Submit([task] {
+            (*task)();
+        });
+    } else {
+        (*task)();
+        InstallMerge(true);
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <execution>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+#include "term_statistics.h"
+#include "thread_pool.h"
+#include "top_k.h"
+
+using namespace std;
+
+struct SegmentedIndexOptions {
+    // столько документов набирает изменяемый сегмент, прежде чем стать неизменяемым
+    size_t flush_document_count = 16384;
+    // столько соседних сегментов одного уровня сливаются в один сегмент следующего уровня
+    size_t merge_factor = 8;
+    // сливать сегменты в общем пуле потоков; иначе слияние идёт внутри вызова, который его запустил
+    bool background_merge = true;
+    // хранить списки вхождений неизменяемых сегментов в сжатом виде
+    bool compress_segments = false;
+};
+
+// Индекс из сегментов: новые документы попадают в небольшой изменяемый сегмент,
+// заполненный сегмент становится неизменяемым, а соседние неизменяемые сегменты
+// одного уровня сливаются в один, заново построенный пакетно. Поиск идёт по всем
+// сегментам, их лучшие документы сливаются. IDF считается по общей статистике,
+// поэтому релевантность та же, что у одного SearchServer со всеми документами,
+// с точностью до порядка сложения вкладов слов.
+// Изменение документа меняет IDF во всех сегментах, но сегменты узнают об этом
+// только перед следующим поиском: серия изменений сбрасывает их кэши один раз.
+// Как и SearchServer, индекс нельзя менять одновременно с поиском; фоновое слияние
+// читает только свою копию документов и подменяет сегменты при следующем изменении индекса
+class SegmentedIndex {
+public:
+    explicit SegmentedIndex(const string& stop_words_text, const SegmentedIndexOptions& options = {});
+
+    // Дожидается фонового слияния
+    ~SegmentedIndex();
+
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    void AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    // Сегменты ищутся параллельно по политике, каждый — последовательно
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    vector<Document> FindTopDocuments(ExecutionPolicy&& policy, string_view raw_query, DocumentPredicate document_predicate,
+                                      const QueryOptions& options = {}) const;
+
+    template <typename ExecutionPolicy>
+    vector<Document> FindTopDocuments(ExecutionPolicy&& policy, string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                      const QueryOptions& options = {}) const {
+        return FindTopDocuments(policy, raw_query, StatusPredicate{status}, options);
+    }
+
+    template <typename DocumentPredicate>
+    vector<Document> FindTopDocuments(string_view raw_query, DocumentPredicate document_predicate, const QueryOptions& options = {}) const {
+        return FindTopDocuments(execution::seq, raw_query, document_predicate, options);
+    }
+
+    vector<Document> FindTopDocuments(string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, const QueryOptions& options = {}) const {
+        return FindTopDocuments(execution::seq, raw_query, StatusPredicate{status}, options);
+    }
+
+    // Слова указывают в словарь сегмента и действительны до следующего изменения индекса
+    tuple<vector<string_view>, DocumentStatus> MatchDocument(string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const {
+        return document_segments_.size();
+    }
+
+    // Число сегментов вместе с изменяемым
+    size_t GetSegmentCount() const {
+        return segments_.size() + 1;
+    }
+
+    // Делает изменяемый сегмент неизменяемым, даже если он не заполнен
+    void Flush();
+
+    // Дожидается слияний, пока политике есть что сливать
+    void WaitForMerges();
+
+private:
+    struct Segment {
+        unique_ptr<SearchServer> server;
+        // сегмент уровня k собран из merge_factor^k заполненных изменяемых сегментов
+        size_t level = 0;
+    };
+
+    // Документы сливаемых сегментов. Тексты скопированы, чтобы сегменты можно было менять во время слияния
+    struct MergeInput {
+        string texts;
+        vector<NewDocument> documents;
+    };
+
+    // Идущее слияние сегментов [first_segment, first_segment + segment_count)
+    struct Merge {
+        size_t first_segment = 0;
+        size_t segment_count = 0;
+        future<unique_ptr<SearchServer>> result;
+        // удалённые из сливаемых сегментов после начала слияния
+        vector<int> removed_document_ids;
+    };
+
+    const string stop_words_text_;
+    const SegmentedIndexOptions options_;
+    shared_ptr<const TermStatistics> statistics_;
+    // неизменяемые сегменты от старых к новым
+    vector<Segment> segments_;
+    unique_ptr<SearchServer> mutable_segment_;
+    unordered_map<int, SearchServer*> document_segments_;
+    unique_ptr<Merge> merge_;
+    // документы менялись после того, как сегменты получили статистику
+    mutable atomic<bool> statistics_stale_{false};
+    mutable mutex statistics_mutex_;
+
+    unique_ptr<SearchServer> MakeSegment(bool compress) const;
+
+    // Собирает статистику заново, когда сменился набор сегментов, и сразу отдаёт её сегментам
+    void RebuildStatistics();
+
+    // Отдаёт сегментам статистику, и они сбрасывают кэши IDF
+    void SetSegmentStatistics() const;
+
+    // Сообщает сегментам об изменениях документов, накопленных с прошлого поиска.
+    // Параллельные поиски ждут, пока один из них не закончит
+    void PublishStaleStatistics() const;
+
+    // Подменяет сегменты результатом завершённого слияния; wait — дождаться идущего
+    void InstallMerge(bool wait);
+
+    // Запускает слияние, если есть merge_factor соседних сегментов одного уровня и ничего не сливается
+    void StartMerge();
+
+    template <typename Function>
+    void ForEachSegment(Function function) const {
+        for (const Segment& segment : segments_) {
+            function(*segment.server);
+        }
+        function(*mutable_segment_);
+    }
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+vector<Document> SegmentedIndex::FindTopDocuments(ExecutionPolicy&& policy, string_view raw_query, DocumentPredicate document_predicate,
+                                                  const QueryOptions& options) const {
+    PublishStaleStatistics();
+    vector<const SearchServer*> servers;
+    servers.reserve(GetSegmentCount());
+    ForEachSegment([&servers](const SearchServer& server) {
+        servers.push_back(&server);
+    });
+
+    vector<vector<Document>> segment_documents(servers.size());
+    vector<size_t> indices(servers.size());
+    iota(indices.begin(), indices.end(), 0);
+    ParallelForEach(policy, indices.begin(), indices.end(), [&](size_t i) {
+        segment_documents[i] = servers[i]->FindTopDocuments(raw_query, document_predicate, options);
+    });
+
+    vector<Document> documents;
+    for (const vector<Document>& segment_top : segment_documents) {
+        documents.insert(documents.end(), segment_top.begin(), segment_top.end());
+    }
+    SelectTop(documents, options.max_result_count, SearchServer::IsMoreRelevant);
+    return documents;
+}
@@ -0,0 +1,53 @@
+#include "term_dictionary.h"
+#include "index_snapshot.h"
+
+#include <utility>
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    words_.reserve(other.words_.size());
+    term_ids_.reserve(other.words_.size());
+    for (const string_view word : other.words_) {
+        Intern(word);
+    }
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(const string_view word) {
+    const auto it = term_ids_.find(word);
+    if (it != term_ids_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(words_.size());
+    const string_view stored_word = owned_words_.emplace_back(word);
+    words_.push_back(stored_word);
+    term_ids_.emplace(stored_word, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(const string_view word) const {
+    const auto it = term_ids_.find(word);
+    return it == term_ids_.end() ? NO_TERM : it->second;
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    writer.WriteStringTable(SnapshotSection::TERM_OFFSETS, SnapshotSection::TERM_CHARS, words_);
+}
+
+void TermDictionary::Load(const SnapshotReader& reader) {
+    owned_words_.clear();
+    words_ = reader.GetStringTable(SnapshotSection::TERM_OFFSETS, SnapshotSection::TERM_CHARS);
+    term_ids_.clear();
+    term_ids_.reserve(words_.size());
+    for (TermId term_id = 0; term_id < words_.size(); ++term_id) {
+        term_ids_.emplace(words_[term_id], term_id);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+using TermId = uint32_t;
+
+const TermId NO_TERM = numeric_limits<TermId>::max();
+
+struct TermCount {
+    TermId term_id;
+    uint32_t term_count;
+};
+
+// Каждое слово хранится один раз и получает плотный номер.
+// Слова лежат либо в собственной памяти словаря, либо в отображённом снимке индекса
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    // Копия хранит все слова в своей памяти: string_view исходного словаря
+    // указывают в его строки и не переживают его
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+
+    // deque при перемещении передаёт свои блоки, и строки остаются на месте
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    TermId Intern(const string_view word);
+
+    TermId Find(const string_view word) const;
+
+    string_view GetWord(TermId term_id) const {
+        return words_[term_id];
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Слова остаются в отображённом файле, строится только хеш-таблица поиска
+    void Load(const SnapshotReader& reader);
+
+private:
+    // deque не перемещает строки при росте, поэтому string_view на них остаются валидными
+    deque<string> owned_words_;
+    vector<string_view> words_;
+    unordered_map<string_view, TermId> term_ids_;
+};
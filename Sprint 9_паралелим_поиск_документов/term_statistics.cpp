@@ -0,0 +1,23 @@
+#include "term_statistics.h"
+
+#include <cmath>
+
+#include "search_server.h"
+
+using namespace std;
+
+int TermStatistics::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer* index : indexes_) {
+        document_count += index->GetDocumentCount();
+    }
+    return document_count;
+}
+
+double TermStatistics::ComputeInverseDocumentFreq(string_view word) const {
+    uint32_t word_document_count = 0;
+    for (const SearchServer* index : indexes_) {
+        word_document_count += index->GetWordDocumentCount(word);
+    }
+    return log(GetDocumentCount() * 1.0 / word_document_count);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+class SearchServer;
+
+// Число документов и число документов со словом, просуммированные по нескольким индексам.
+// По ней сегменты SegmentedIndex считают одинаковые IDF, поэтому их релевантности сравнимы.
+// Сами индексы статистику не пополняют: суммы берутся при расчёте IDF, который кэшируется до изменения индекса
+class TermStatistics {
+public:
+    explicit TermStatistics(vector<const SearchServer*> indexes)
+        : indexes_(move(indexes)) {
+    }
+
+    int GetDocumentCount() const;
+
+    // Та же формула, что у SearchServer для своих документов
+    double ComputeInverseDocumentFreq(string_view word) const;
+
+private:
+    vector<const SearchServer*> indexes_;
+};
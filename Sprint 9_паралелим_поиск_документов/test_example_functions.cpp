@@ -0,0 +1,1030 @@
+#include "test_example_functions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "index_snapshot.h"
+#include "score_accumulator.h"
+#include "search_server.h"
+#include "segmented_index.h"
+#include "test_framework.h"
+#include "thread_local_pool.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+// Релевантность TF-IDF, посчитанная прямо по текстам живых документов
+class ReferenceIndex {
+public:
+    explicit ReferenceIndex(const string& stop_words_text) {
+        for (const string_view word : SplitIntoWords(stop_words_text)) {
+            stop_words_.emplace(word);
+        }
+    }
+
+    void AddDocument(int document_id, const string& text, DocumentStatus status) {
+        Document& document = documents_[document_id];
+        document.status = status;
+        for (const string_view word : SplitIntoWords(text)) {
+            if (stop_words_.count(string(word)) == 0) {
+                ++document.word_counts[string(word)];
+                ++document.word_count;
+            }
+        }
+    }
+
+    void RemoveDocument(int document_id) {
+        documents_.erase(document_id);
+    }
+
+    // Релевантность каждого документа со статусом status, подходящего под запрос
+    map<int, double> Score(const string& raw_query, DocumentStatus status) const {
+        set<string> plus_words;
+        set<string> minus_words;
+        for (const string_view word : SplitIntoWords(raw_query)) {
+            if (word[0] == '-') {
+                minus_words.emplace(word.substr(1));
+            } else {
+                plus_words.emplace(word);
+            }
+        }
+
+        map<int, double> relevances;
+        for (const auto& [document_id, document] : documents_) {
+            if (document.status != status || any_of(minus_words.begin(), minus_words.end(), [&document](const string& word) {
+                    return document.word_counts.count(word) > 0;
+                })) {
+                continue;
+            }
+            double relevance = 0.0;
+            bool matched = false;
+            for (const string& word : plus_words) {
+                const auto it = document.word_counts.find(word);
+                if (it == document.word_counts.end()) {
+                    continue;
+                }
+                matched = true;
+                relevance += it->second * 1.0 / document.word_count * ComputeInverseDocumentFreq(word);
+            }
+            if (matched) {
+                relevances[document_id] = relevance;
+            }
+        }
+        return relevances;
+    }
+
+private:
+    struct Document {
+        DocumentStatus status;
+        map<string, int> word_counts;
+        int word_count = 0;
+    };
+
+    set<string> stop_words_;
+    map<int, Document> documents_;
+
+    double ComputeInverseDocumentFreq(const string& word) const {
+        const auto document_count = count_if(documents_.begin(), documents_.end(), [&word](const auto& document) {
+            return document.second.word_counts.count(word) > 0;
+        });
+        return log(documents_.size() * 1.0 / document_count);
+    }
+};
+
+// Документы — лучшие max_result_count из reference: их релевантности совпадают с эталонными,
+// а при равной релевантности допускается любой из равных документов
+void AssertMatchesReference(const vector<Document>& documents, const map<int, double>& reference, const string& hint,
+                            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) {
+    ASSERT_HINT(documents.size() == min(max_result_count, reference.size()), hint);
+    vector<double> expected;
+    for (const auto& [document_id, relevance] : reference) {
+        expected.push_back(relevance);
+    }
+    sort(expected.begin(), expected.end(), greater<>());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto it = reference.find(documents[i].id);
+        ASSERT_HINT(it != reference.end(), hint);
+        // сравнение с NaN ложно
+        ASSERT_HINT(abs(documents[i].relevance - it->second) < 1e-9, hint);
+        ASSERT_HINT(abs(documents[i].relevance - expected[i]) < EPS, hint);
+    }
+}
+
+// Текст из word_count слов; слова с малыми номерами встречаются чаще
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_probability = 0.0) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0.0, 1.0)(generator) < minus_probability) {
+            text.push_back('-');
+        }
+        const int limit = uniform_int_distribution<int>(1, dictionary.size())(generator);
+        text += dictionary[uniform_int_distribution<int>(0, limit - 1)(generator)];
+    }
+    return text;
+}
+
+vector<string> GenerateDictionary(const string& prefix, int word_count) {
+    vector<string> dictionary;
+    for (int i = 0; i < word_count; ++i) {
+        dictionary.push_back(prefix + to_string(i));
+    }
+    return dictionary;
+}
+
+// Слово, все документы которого удалены, не участвует в поиске. Его IDF бесконечен,
+// а в паре из кэша у документов второго слова его частота нулевая, и 0 * inf дало бы NaN
+void TestRemovedWordDoesNotPoisonCachedPair() {
+    SearchServer server(""s);
+    server.SetPostingCacheMemoryLimit(1 << 20);
+    server.AddDocument(1, "alpha beta"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "beta gamma"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "gamma delta"s, DocumentStatus::ACTUAL, {3});
+    server.RemoveDocument(1);
+
+    const double expected_relevance = log(2.0) * 0.5;
+    const auto any_document = [](int, DocumentStatus, int) {
+        return true;
+    };
+    QueryOptions max_score;
+    max_score.scoring_mode = ScoringMode::MAX_SCORE;
+    // пара допускается в кэш не с первого запроса
+    for (int i = 0; i < 20; ++i) {
+        for (const vector<Document>& documents : {server.FindTopDocuments("alpha beta"s), server.FindTopDocuments("alpha beta"s, any_document),
+                                                  server.FindTopDocuments("alpha beta"s, DocumentStatus::ACTUAL, max_score),
+                                                  server.FindTopDocuments(execution::par, "alpha beta"s)}) {
+            ASSERT_EQUAL(documents.size(), 1u);
+            ASSERT_EQUAL(documents[0].id, 2);
+            ASSERT(abs(documents[0].relevance - expected_relevance) < 1e-12);
+        }
+        // пара двух живых слов по-прежнему берётся из кэша
+        const vector<Document> documents = server.FindTopDocuments("alpha beta gamma"s);
+        ASSERT_EQUAL(documents.size(), 2u);
+        ASSERT_EQUAL(documents[0].id, 2);
+        ASSERT(abs(documents[0].relevance - expected_relevance) < 1e-12);
+        ASSERT_EQUAL(documents[1].id, 3);
+    }
+    ASSERT(server.GetPostingCacheStats().hits > 0);
+
+    const auto [words, status] = server.MatchDocument("alpha beta"s, 2);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "beta"s);
+}
+
+// Удалённые документы остаются в списках до уплотнения, но выдача и до, и после Compact
+// совпадает с подсчётом по живым документам, в том числе по словам, документов которых не осталось
+void TestRemoveAndCompactMatchReference() {
+    mt19937 generator(24);
+    const vector<string> dictionary = GenerateDictionary("w"s, 40);
+    SearchServer server("w1 w7"s);
+    ReferenceIndex reference("w1 w7"s);
+    server.SetCompactionThreshold(1.0);
+    server.SetPostingCacheMemoryLimit(1 << 20);
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        // у части документов есть своё слово, которое пропадёт из индекса вместе с документом
+        string text = GenerateText(generator, dictionary, uniform_int_distribution(1, 12)(generator));
+        if (document_id % 4 == 0) {
+            text += " u"s + to_string(document_id);
+        }
+        const DocumentStatus status = document_id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(document_id, text, status, {document_id});
+        reference.AddDocument(document_id, text, status);
+    }
+    vector<string> queries;
+    for (int i = 0; i < 60; ++i) {
+        string query = GenerateText(generator, dictionary, uniform_int_distribution(1, 5)(generator), 0.15);
+        query += " u"s + to_string(uniform_int_distribution(0, 99)(generator) * 4);
+        queries.push_back(query);
+    }
+
+    QueryOptions max_score;
+    max_score.scoring_mode = ScoringMode::MAX_SCORE;
+    const auto check = [&](const string& stage) {
+        vector<vector<Document>> results;
+        // повторы запросов допускают их пары в кэш
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            for (const string& query : queries) {
+                const string hint = stage + ": "s + query;
+                for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                    const map<int, double> expected = reference.Score(query, status);
+                    results.push_back(server.FindTopDocuments(query, status));
+                    AssertMatchesReference(results.back(), expected, hint);
+                    AssertMatchesReference(server.FindTopDocuments(query, status, max_score), expected, hint);
+                    AssertMatchesReference(server.FindTopDocuments(query, [status](int, DocumentStatus document_status, int) {
+                        return document_status == status;
+                    }), expected, hint);
+                }
+            }
+        }
+        return results;
+    };
+
+    check("added"s);
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        if (document_id % 3 == 0 || document_id % 8 == 4) {
+            server.RemoveDocument(document_id);
+            reference.RemoveDocument(document_id);
+        }
+    }
+    const auto removed_results = check("removed"s);
+    server.Compact();
+    const auto compacted_results = check("compacted"s);
+
+    // уплотнение не меняет ни выдачи, ни релевантности
+    ASSERT_EQUAL(removed_results.size(), compacted_results.size());
+    for (size_t i = 0; i < removed_results.size(); ++i) {
+        ASSERT_EQUAL(removed_results[i].size(), compacted_results[i].size());
+        for (size_t j = 0; j < removed_results[i].size(); ++j) {
+            ASSERT_EQUAL(removed_results[i][j].id, compacted_results[i][j].id);
+            ASSERT_EQUAL(removed_results[i][j].relevance, compacted_results[i][j].relevance);
+        }
+    }
+}
+
+// Без порога уплотнения удаление не перестраивает индекс, даже если удалены почти все документы:
+// слова, полученные раньше, лежат там же
+void TestRemoveDocumentDoesNotCompactByDefault() {
+    SearchServer server(""s);
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        server.AddDocument(document_id, "common word"s + to_string(document_id), DocumentStatus::ACTUAL, {1});
+    }
+    const auto [words, status] = server.MatchDocument("common"s, 99);
+    ASSERT_EQUAL(words.size(), 1u);
+    for (int document_id = 0; document_id < 99; ++document_id) {
+        server.RemoveDocument(document_id);
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    const auto [remaining_words, remaining_status] = server.MatchDocument("common"s, 99);
+    ASSERT_EQUAL(remaining_words.size(), 1u);
+    ASSERT(remaining_words[0].data() == words[0].data());
+    ASSERT_EQUAL(words[0], "common"s);
+}
+
+// Документы и запросы, на которых способы поиска сверяются с полным последовательным подсчётом.
+// У каждого шестого документа есть своё слово, и каждый запрос ищет одно из таких слов
+struct SearchFixture {
+    string stop_words = "w2 w9"s;
+    vector<NewDocument> documents;
+    vector<string> queries;
+    vector<DocumentStatus> statuses = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED};
+    vector<int> removed_ids;
+
+    SearchFixture() {
+        mt19937 generator(16);
+        const vector<string> dictionary = GenerateDictionary("w"s, 60);
+        for (int document_id = 0; document_id < 700; ++document_id) {
+            texts_.push_back(GenerateText(generator, dictionary, uniform_int_distribution(1, 15)(generator)));
+            if (document_id % 6 == 0) {
+                texts_.back() += " u"s + to_string(document_id);
+            }
+        }
+        for (int document_id = 0; document_id < 700; ++document_id) {
+            documents.push_back({document_id, texts_[document_id], static_cast<DocumentStatus>(document_id % 7 % DOCUMENT_STATUS_COUNT), {document_id, 1}});
+            if (document_id % 3 == 0 || document_id % 12 == 5) {
+                removed_ids.push_back(document_id);
+            }
+        }
+        for (int i = 0; i < 80; ++i) {
+            queries.push_back(GenerateText(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2) + " u"s
+                              + to_string(uniform_int_distribution(0, 116)(generator) * 6));
+        }
+    }
+
+private:
+    // тексты, на которые ссылаются documents
+    vector<string> texts_;
+};
+
+enum class IndexState {
+    ADDED,
+    REMOVED,
+    COMPACTED,
+};
+
+string GetStateName(IndexState state) {
+    switch (state) {
+        case IndexState::ADDED:
+            return "added"s;
+        case IndexState::REMOVED:
+            return "removed"s;
+        default:
+            return "compacted"s;
+    }
+}
+
+// Выдача полного последовательного подсчёта по каждому запросу и статусу
+using ExpectedResults = map<pair<string, DocumentStatus>, vector<Document>>;
+
+// Вызывает check(server, expected, state) после добавления документов, после удаления части
+// из них и после Compact. expected сверена с подсчётом по текстам
+template <typename Check>
+void ForEachIndexState(const SearchFixture& fixture, Check check) {
+    SearchServer server(fixture.stop_words);
+    ReferenceIndex reference(fixture.stop_words);
+    for (const NewDocument& document : fixture.documents) {
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+        reference.AddDocument(document.id, string(document.text), document.status);
+    }
+    const auto run = [&](IndexState state) {
+        ExpectedResults expected;
+        for (const string& query : fixture.queries) {
+            for (const DocumentStatus status : fixture.statuses) {
+                expected[{query, status}] = server.FindTopDocuments(query, status);
+                AssertMatchesReference(expected[{query, status}], reference.Score(query, status), GetStateName(state) + ": "s + query);
+            }
+        }
+        check(server, expected, state);
+    };
+
+    run(IndexState::ADDED);
+    for (const int document_id : fixture.removed_ids) {
+        server.RemoveDocument(document_id);
+        reference.RemoveDocument(document_id);
+    }
+    run(IndexState::REMOVED);
+    server.Compact();
+    run(IndexState::COMPACTED);
+}
+
+// Те же документы в том же порядке и с теми же до бита релевантностями
+void AssertSameDocuments(const vector<Document>& documents, const vector<Document>& expected, const string& hint) {
+    ASSERT_HINT(documents.size() == expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_HINT(documents[i].id == expected[i].id && documents[i].relevance == expected[i].relevance && documents[i].rating == expected[i].rating,
+                    hint);
+    }
+}
+
+// search(query, status) возвращает то же, что полный последовательный подсчёт
+template <typename Search>
+void AssertSearchMatches(const SearchFixture& fixture, const ExpectedResults& expected, const string& hint, Search search) {
+    for (const string& query : fixture.queries) {
+        for (const DocumentStatus status : fixture.statuses) {
+            AssertSameDocuments(search(query, status), expected.at({query, status}), hint + ": "s + query);
+        }
+    }
+}
+
+// Диапазоны документов дают ту же выдачу, что и обход по словам, при любом числе
+// диапазонов и результатов, в том числе когда нужны все документы
+void TestRangeShardsMatchExhaustiveSearch() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        for (const size_t shard_count : {1u, 3u, 8u}) {
+            for (const ScoringMode scoring_mode : {ScoringMode::EXHAUSTIVE, ScoringMode::MAX_SCORE}) {
+                QueryOptions options;
+                options.parallel_mode = ParallelMode::BY_DOCUMENT_RANGES;
+                options.shard_count = shard_count;
+                options.scoring_mode = scoring_mode;
+                const string hint = GetStateName(state) + " by ranges "s + to_string(shard_count);
+                AssertSearchMatches(fixture, expected, hint, [&](const string& query, DocumentStatus status) {
+                    return server.FindTopDocuments(execution::par, query, status, options);
+                });
+            }
+        }
+
+        QueryOptions all_documents;
+        all_documents.max_result_count = numeric_limits<size_t>::max();
+        QueryOptions all_documents_by_ranges = all_documents;
+        all_documents_by_ranges.parallel_mode = ParallelMode::BY_DOCUMENT_RANGES;
+        all_documents_by_ranges.shard_count = 3;
+        for (const string& query : fixture.queries) {
+            const vector<Document> documents = server.FindTopDocuments(query, DocumentStatus::ACTUAL, all_documents);
+            AssertSameDocuments(server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, all_documents_by_ranges), documents,
+                                GetStateName(state) + " all by ranges: "s + query);
+        }
+    });
+}
+
+// Пока объект занят, поток получает из пула другой, а освобождённый достаётся следующему запросу
+void TestThreadLocalPoolHandsOutFreeObjects() {
+    const vector<int>* first_object = nullptr;
+    {
+        const auto outer = ThreadLocalPool<vector<int>>::Acquire();
+        outer->push_back(1);
+        first_object = &*outer;
+        const auto inner = ThreadLocalPool<vector<int>>::Acquire();
+        ASSERT(&*inner != first_object);
+        ASSERT(inner->empty());
+        ASSERT_EQUAL(outer->size(), 1u);
+    }
+    const auto reused = ThreadLocalPool<vector<int>>::Acquire();
+    ASSERT(&*reused == first_object || reused->empty());
+}
+
+// Предикат, который сам ищет по индексу, запускает запрос в том же потоке посреди подсчёта
+// внешнего. Так же поток, ждущий параллельную часть запроса, может взяться за чужой запрос.
+// Вложенный запрос не должен портить ни исключения, ни накопитель внешнего
+void TestReentrantQueryKeepsOuterState() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        QueryOptions max_score;
+        max_score.scoring_mode = ScoringMode::MAX_SCORE;
+        for (const DocumentStatus status : fixture.statuses) {
+            for (size_t i = 0; i < fixture.queries.size(); ++i) {
+                const string& inner_query = fixture.queries[(i + 1) % fixture.queries.size()];
+                const auto reentrant_predicate = [&](int, DocumentStatus document_status, int) {
+                    server.FindTopDocuments(inner_query, status);
+                    server.FindTopDocuments(execution::par, inner_query, status);
+                    return document_status == status;
+                };
+                const string hint = GetStateName(state) + " reentrant: "s + fixture.queries[i];
+                const vector<Document>& documents = expected.at({fixture.queries[i], status});
+                AssertSameDocuments(server.FindTopDocuments(fixture.queries[i], reentrant_predicate), documents, hint);
+                AssertSameDocuments(server.FindTopDocuments(fixture.queries[i], reentrant_predicate, max_score), documents, hint + " max score"s);
+                AssertSameDocuments(server.FindTopDocuments(execution::par, fixture.queries[i], reentrant_predicate), documents, hint + " by words"s);
+            }
+        }
+    });
+}
+
+// В запросе из одних минус-слов подсчёта нет, и отмену проверяет только сбор исключений
+void TestCancelledQueryStopsWhileCollectingExclusions() {
+    SearchServer server(""s);
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        server.AddDocument(document_id, "cat dog"s + to_string(document_id % 10), DocumentStatus::ACTUAL, {1});
+    }
+    QueryOptions options;
+    options.cancellation = CancellationToken::Create();
+    options.cancellation.Cancel();
+    QueryOptions ranges = options;
+    ranges.parallel_mode = ParallelMode::BY_DOCUMENT_RANGES;
+    QueryOptions max_score = options;
+    max_score.scoring_mode = ScoringMode::MAX_SCORE;
+    server.SetPostingCacheMemoryLimit(1 << 20);
+    // второй и третий повтор берут объединение минус-слов из кэша
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        for (const string& query : {"-cat"s, "-cat -dog1"s}) {
+            const vector<function<void()>> searches = {
+                [&] { server.FindTopDocuments(query, DocumentStatus::ACTUAL, options); },
+                [&] { server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_score); },
+                [&] { server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, options); },
+                [&] { server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, ranges); },
+                [&] { server.FindTopDocumentsBatch(execution::seq, vector<string>{query}, DocumentStatus::ACTUAL, options); },
+            };
+            for (const auto& search : searches) {
+                bool cancelled = false;
+                try {
+                    search();
+                } catch (const QueryCancelled&) {
+                    cancelled = true;
+                }
+                ASSERT_HINT(cancelled, query);
+            }
+            // без отмены такой запрос ничего не находит
+            ASSERT(server.FindTopDocuments(query).empty());
+        }
+    }
+}
+
+// Пакет запросов даёт ту же выдачу, что и каждый запрос по отдельности
+void TestBatchMatchesSingleQueries() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        for (const DocumentStatus status : fixture.statuses) {
+            const auto sequential = server.FindTopDocumentsBatch(execution::seq, fixture.queries, status);
+            const auto parallel = server.FindTopDocumentsBatch(execution::par, fixture.queries, status);
+            for (size_t i = 0; i < fixture.queries.size(); ++i) {
+                const string hint = GetStateName(state) + " batch: "s + fixture.queries[i];
+                AssertSameDocuments(sequential[i], expected.at({fixture.queries[i], status}), hint);
+                AssertSameDocuments(parallel[i], expected.at({fixture.queries[i], status}), hint);
+            }
+        }
+    });
+}
+
+// Индекс больше нескольких полос накопителя: документы и минус-слова на границах полос
+// учитываются один раз
+void TestBatchSpansDocumentTiles() {
+    mt19937 generator(19);
+    const vector<string> dictionary = GenerateDictionary("w"s, 30);
+    const int document_count = static_cast<int>(BATCH_TILE_DOCUMENT_COUNT * 5 / 2);
+    vector<string> texts;
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        texts.push_back(GenerateText(generator, dictionary, uniform_int_distribution(1, 4)(generator)));
+    }
+    vector<NewDocument> documents;
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        documents.push_back({document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id}});
+    }
+    SearchServer server(""s);
+    server.AddDocuments(execution::par, documents);
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i) {
+        queries.push_back(GenerateText(generator, dictionary, uniform_int_distribution(1, 4)(generator), 0.3));
+    }
+    QueryOptions options;
+    options.max_result_count = 50;
+    const auto batch = server.FindTopDocumentsBatch(execution::par, queries, DocumentStatus::ACTUAL, options);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        AssertSameDocuments(batch[i], server.FindTopDocuments(queries[i], DocumentStatus::ACTUAL, options), "tiles: "s + queries[i]);
+    }
+}
+
+// Пары плюс-слов из кэша дают ту же выдачу, что и обход по одному слову
+void TestPostingCacheMatchesUncachedSearch() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        server.SetPostingCacheMemoryLimit(1 << 22);
+        // пары и наборы минус-слов допускаются в кэш не с первого запроса
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            const string hint = GetStateName(state) + " posting cache"s;
+            AssertSearchMatches(fixture, expected, hint, [&server](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(query, status);
+            });
+            AssertSearchMatches(fixture, expected, hint + " by words"s, [&server](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(execution::par, query, status);
+            });
+        }
+        ASSERT(server.GetPostingCacheStats().hits > 0);
+        server.SetPostingCacheMemoryLimit(0);
+    });
+}
+
+// Частая пара попадает в кэш и там, где перед ней в запросе стоит редкое слово:
+// каждая пара с редким словом предлагается кэшу меньше раз, чем нужно для допуска
+void TestPostingCacheAdmitsPairAfterFirstWord() {
+    const int prefix_count = 40;
+    string prefixes;
+    for (int prefix = 0; prefix < prefix_count; ++prefix) {
+        prefixes += " prefix"s + to_string(prefix);
+    }
+    SearchServer server(""s);
+    SearchServer uncached(""s);
+    server.SetPostingCacheMemoryLimit(1 << 20);
+    // слова prefix получают меньшие номера, чем cat и dog, и в запросе идут первыми
+    for (SearchServer* target : {&server, &uncached}) {
+        target->AddDocument(0, prefixes, DocumentStatus::ACTUAL, {0});
+        for (int document_id = 1; document_id < 200; ++document_id) {
+            const string text = (document_id % 3 == 0 ? "cat"s : "dog"s) + (document_id % 5 == 0 ? " cat dog"s : " bird"s) + " prefix"s
+                                + to_string(document_id % prefix_count);
+            target->AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id});
+        }
+    }
+    for (int repeat = 0; repeat < 2; ++repeat) {
+        for (int prefix = 0; prefix < prefix_count; ++prefix) {
+            const string query = "prefix"s + to_string(prefix) + " cat dog"s;
+            AssertSameDocuments(server.FindTopDocuments(query), uncached.FindTopDocuments(query), query);
+        }
+    }
+    ASSERT(server.GetPostingCacheStats().hits > 0);
+}
+
+// Снимок, открытый с проверкой контрольной суммы и без неё, ищет так же, как индекс, из которого сохранён
+void TestSnapshotMatchesSavedIndex() {
+    const SearchFixture fixture;
+    const string path = "test_snapshot.bin"s;
+    ForEachIndexState(fixture, [&fixture, &path](SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        for (const bool compress_postings : {false, true}) {
+            server.SetPostingCompression(compress_postings);
+            server.SaveSnapshot(path);
+            for (const bool verify_checksum : {true, false}) {
+                SnapshotOpenOptions options;
+                options.verify_checksum = verify_checksum;
+                const SearchServer snapshot = SearchServer::OpenSnapshot(path, options);
+                const string hint = GetStateName(state) + (verify_checksum ? " verified snapshot"s : " unverified snapshot"s);
+                AssertSearchMatches(fixture, expected, hint, [&snapshot](const string& query, DocumentStatus status) {
+                    return snapshot.FindTopDocuments(query, status);
+                });
+            }
+        }
+        server.SetPostingCompression(false);
+    });
+    remove(path.c_str());
+}
+
+// Без проверки контрольной суммы испорченные списки вхождений не читаются при открытии,
+// а обнаруживаются первым поиском по ним
+void TestCorruptedSnapshotPostingsThrowOnFirstUse() {
+    const SearchFixture fixture;
+    SearchServer server(fixture.stop_words);
+    for (const NewDocument& document : fixture.documents) {
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    server.SetPostingCompression(true);
+    const string path = "test_snapshot.bin"s;
+    server.SaveSnapshot(path);
+
+    size_t data_begin = 0;
+    size_t data_size = 0;
+    {
+        const SnapshotReader reader(path, true);
+        const string_view data = reader.GetSection(SnapshotSection::POSTING_DATA);
+        data_begin = static_cast<size_t>(data.data() - reader.GetFile()->data());
+        data_size = data.size();
+    }
+    {
+        // номера 0xFFFFFFFF выходят за число документов в каждом списке
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(static_cast<streamoff>(data_begin));
+        const string garbage(data_size, '\xFF');
+        file.write(garbage.data(), static_cast<streamsize>(garbage.size()));
+    }
+
+    bool verified_open_failed = false;
+    try {
+        SearchServer::OpenSnapshot(path);
+    } catch (const runtime_error&) {
+        verified_open_failed = true;
+    }
+    ASSERT(verified_open_failed);
+
+    SnapshotOpenOptions options;
+    options.verify_checksum = false;
+    const SearchServer snapshot = SearchServer::OpenSnapshot(path, options);
+    for (const string& query : fixture.queries) {
+        if (server.FindTopDocuments(query).empty()) {
+            continue;
+        }
+        bool search_failed = false;
+        try {
+            snapshot.FindTopDocuments(query);
+        } catch (const runtime_error&) {
+            search_failed = true;
+        }
+        ASSERT_HINT(search_failed, query);
+    }
+    remove(path.c_str());
+}
+
+// Сегменты получают статистику, изменённую серией добавлений и удалений, перед первым поиском после неё,
+// и релевантность совпадает с полным подсчётом по всем документам при любом ходе слияний
+void TestSegmentedIndexMatchesReference() {
+    const SearchFixture fixture;
+    for (const bool background_merge : {false, true}) {
+        SegmentedIndexOptions options;
+        options.flush_document_count = 37;
+        options.merge_factor = 3;
+        options.background_merge = background_merge;
+        SegmentedIndex index(fixture.stop_words, options);
+        ReferenceIndex reference(fixture.stop_words);
+        const auto check = [&](const string& stage) {
+            for (const string& query : fixture.queries) {
+                for (const DocumentStatus status : fixture.statuses) {
+                    const string hint = stage + (background_merge ? " background: "s : " synchronous: "s) + query;
+                    AssertMatchesReference(index.FindTopDocuments(query, status), reference.Score(query, status), hint);
+                }
+            }
+        };
+
+        for (const NewDocument& document : fixture.documents) {
+            index.AddDocument(document.id, document.text, document.status, document.ratings);
+            reference.AddDocument(document.id, string(document.text), document.status);
+            // проверки идут и между сбросами сегментов, когда кэши IDF уже заполнены прошлым поиском
+            if (document.id % 60 == 59) {
+                check("added "s + to_string(document.id + 1));
+            }
+        }
+        for (size_t i = 0; i < fixture.removed_ids.size(); ++i) {
+            index.RemoveDocument(fixture.removed_ids[i]);
+            reference.RemoveDocument(fixture.removed_ids[i]);
+            if (i % 100 == 99) {
+                check("removed "s + to_string(i + 1));
+            }
+        }
+        check("removed"s);
+        index.Flush();
+        index.WaitForMerges();
+        check("merged"s);
+    }
+}
+
+// Сжатые списки вхождений дают ту же выдачу, что и несжатые, и после обратной распаковки
+void TestCompressedPostingsMatchPlain() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        QueryOptions max_score;
+        max_score.scoring_mode = ScoringMode::MAX_SCORE;
+        server.SetPostingCompression(true);
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " compressed"s, [&server](const string& query, DocumentStatus status) {
+            return server.FindTopDocuments(query, status);
+        });
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " compressed max score"s, [&](const string& query, DocumentStatus status) {
+            return server.FindTopDocuments(query, status, max_score);
+        });
+        server.SetPostingCompression(false);
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " decompressed"s, [&server](const string& query, DocumentStatus status) {
+            return server.FindTopDocuments(query, status);
+        });
+    });
+}
+
+// Лучшие k документов совпадают по релевантности с началом полной выдачи при любом k
+void TestTopKIsPrefixOfAllDocuments() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults&, IndexState state) {
+        QueryOptions all_documents;
+        all_documents.max_result_count = numeric_limits<size_t>::max();
+        for (const string& query : fixture.queries) {
+            for (const DocumentStatus status : fixture.statuses) {
+                const vector<Document> documents = server.FindTopDocuments(query, status, all_documents);
+                ASSERT(is_sorted(documents.begin(), documents.end(), SearchServer::IsMoreRelevant));
+                for (const size_t max_result_count : {0u, 1u, 3u, 10u, 1000u}) {
+                    QueryOptions options;
+                    options.max_result_count = max_result_count;
+                    const vector<Document> top = server.FindTopDocuments(query, status, options);
+                    const string hint = GetStateName(state) + " top "s + to_string(max_result_count) + ": "s + query;
+                    ASSERT_HINT(top.size() == min(max_result_count, documents.size()), hint);
+                    for (size_t i = 0; i < top.size(); ++i) {
+                        ASSERT_HINT(abs(top[i].relevance - documents[i].relevance) < EPS, hint);
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Накопитель в плотном и разреженном режимах считает те же суммы, что и map,
+// и не переносит баллы прошлого запроса в следующий
+void TestScoreAccumulatorMatchesMap() {
+    mt19937 generator(10);
+    ScoreAccumulator accumulator;
+    const size_t document_count = 1000;
+    for (const size_t candidate_bound : {SPARSE_ACCUMULATOR_LIMIT / 2, SPARSE_ACCUMULATOR_LIMIT * 4, document_count, SPARSE_ACCUMULATOR_LIMIT / 2}) {
+        accumulator.Reset(document_count, candidate_bound);
+        map<uint32_t, double> expected;
+        for (size_t i = 0; i < candidate_bound; ++i) {
+            const uint32_t ordinal = uniform_int_distribution<uint32_t>(0, document_count - 1)(generator);
+            const double score = uniform_real_distribution<>(0.0, 1.0)(generator);
+            accumulator.Add(ordinal, score);
+            expected[ordinal] += score;
+        }
+
+        map<uint32_t, double> scores;
+        accumulator.ForEach([&scores](uint32_t ordinal, double score) {
+            ASSERT(scores.count(ordinal) == 0);
+            scores[ordinal] = score;
+        });
+        ASSERT_EQUAL(scores.size(), expected.size());
+        for (const auto& [ordinal, score] : expected) {
+            ASSERT(abs(scores.at(ordinal) - score) < 1e-12);
+        }
+    }
+}
+
+// Параллельный подсчёт по словам даёт ту же выдачу, что и последовательный
+void TestParallelByWordsMatchesSequential() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " by words"s, [&server](const string& query, DocumentStatus status) {
+            return server.FindTopDocuments(execution::par, query, status);
+        });
+    });
+}
+
+// MaxScore отбрасывает только документы, которые не могут попасть в лучшие,
+// поэтому выдача совпадает с полным подсчётом при любом числе результатов
+void TestMaxScoreMatchesExhaustive() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        QueryOptions max_score;
+        max_score.scoring_mode = ScoringMode::MAX_SCORE;
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " max score"s, [&](const string& query, DocumentStatus status) {
+            return server.FindTopDocuments(query, status, max_score);
+        });
+
+        for (const size_t max_result_count : {1u, 20u}) {
+            QueryOptions exhaustive;
+            exhaustive.max_result_count = max_result_count;
+            max_score.max_result_count = max_result_count;
+            for (const string& query : fixture.queries) {
+                const vector<Document> documents = server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_score);
+                const vector<Document> reference = server.FindTopDocuments(query, DocumentStatus::ACTUAL, exhaustive);
+                const string hint = GetStateName(state) + " max score top "s + to_string(max_result_count) + ": "s + query;
+                ASSERT_HINT(documents.size() == reference.size(), hint);
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_HINT(abs(documents[i].relevance - reference[i].relevance) < EPS, hint);
+                }
+            }
+        }
+    });
+}
+
+// Фильтр по битовой карте статуса отбирает те же документы, что и предикат, который вызывается на каждом документе
+void TestStatusBitmapMatchesLambdaPredicate() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        QueryOptions max_score;
+        max_score.scoring_mode = ScoringMode::MAX_SCORE;
+        for (const QueryOptions& options : {QueryOptions{}, max_score}) {
+            const string hint = GetStateName(state) + " lambda predicate"s;
+            AssertSearchMatches(fixture, expected, hint, [&](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(query, [status](int, DocumentStatus document_status, int) {
+                    return document_status == status;
+                }, options);
+            });
+            AssertSearchMatches(fixture, expected, hint + " par"s, [&](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(execution::par, query, [status](int, DocumentStatus document_status, int) {
+                    return document_status == status;
+                }, options);
+            });
+        }
+    });
+}
+
+// Кэш выдачи отвечает на повтор запроса, в том числе с переставленными словами, тем же,
+// что и подсчёт. Кэш включается один раз, и после удаления и сжатия индекса
+// ForEachIndexState сверяет выдачу через кэш с полным подсчётом заново
+void TestResultCacheMatchesUncachedSearch() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        if (state == IndexState::ADDED) {
+            server.SetResultCacheCapacity(1000);
+        }
+        const uint64_t hits = server.GetResultCacheStats().hits;
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            AssertSearchMatches(fixture, expected, GetStateName(state) + " cached"s, [&server](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(query, status);
+            });
+        }
+        AssertSearchMatches(fixture, expected, GetStateName(state) + " cached reversed"s, [&server](const string& query, DocumentStatus status) {
+            const vector<string_view> words = SplitIntoWords(query);
+            string reversed;
+            for (auto it = words.rbegin(); it != words.rend(); ++it) {
+                reversed += string(*it) + " "s;
+            }
+            return server.FindTopDocuments(reversed, status);
+        });
+        ASSERT(server.GetResultCacheStats().hits >= hits + 2 * fixture.queries.size() * fixture.statuses.size());
+    });
+}
+
+// Пакетное добавление строит тот же индекс, что и добавление по одному: выдача совпадает
+// и после удаления части документов и сжатия. Пакет с неверным документом не добавляет ни одного
+void TestAddDocumentsMatchesAddDocument() {
+    const SearchFixture fixture;
+    SearchServer server(fixture.stop_words);
+    for (const NewDocument& document : fixture.documents) {
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    SearchServer bulk(fixture.stop_words);
+    const auto middle = fixture.documents.begin() + fixture.documents.size() / 3;
+    bulk.AddDocuments(execution::par, vector<NewDocument>(fixture.documents.begin(), middle));
+    bulk.AddDocuments(execution::par, vector<NewDocument>(middle, fixture.documents.end()));
+
+    bool rejected = false;
+    try {
+        bulk.AddDocuments(execution::par, vector<NewDocument>{{1000, "w1"sv, DocumentStatus::ACTUAL, {1}}, fixture.documents[0]});
+    } catch (const invalid_argument&) {
+        rejected = true;
+    }
+    ASSERT(rejected);
+    ASSERT_EQUAL(bulk.GetDocumentCount(), server.GetDocumentCount());
+
+    const auto check = [&](const string& stage) {
+        for (const string& query : fixture.queries) {
+            for (const DocumentStatus status : fixture.statuses) {
+                AssertSameDocuments(bulk.FindTopDocuments(query, status), server.FindTopDocuments(query, status), stage + ": "s + query);
+            }
+        }
+    };
+    check("bulk added"s);
+    for (const int document_id : fixture.removed_ids) {
+        server.RemoveDocument(document_id);
+        bulk.RemoveDocument(execution::par, document_id);
+    }
+    check("bulk removed"s);
+    server.Compact();
+    bulk.Compact();
+    check("bulk compacted"s);
+}
+
+// Поиск в своём пуле потоков даёт ту же выдачу, что и последовательный, в обоих режимах распараллеливания
+void TestThreadPoolPolicyMatchesSequential() {
+    const SearchFixture fixture;
+    ThreadPool pool(3);
+    ForEachIndexState(fixture, [&fixture, &pool](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        QueryOptions by_ranges;
+        by_ranges.parallel_mode = ParallelMode::BY_DOCUMENT_RANGES;
+        for (const QueryOptions& options : {QueryOptions{}, by_ranges}) {
+            AssertSearchMatches(fixture, expected, GetStateName(state) + " thread pool"s, [&](const string& query, DocumentStatus status) {
+                return server.FindTopDocuments(ThreadPoolPolicy(pool), query, status, options);
+            });
+        }
+    });
+}
+
+// Вложенный ParallelFor из потоков пула не блокируется, а исключение доходит до вызывающего
+void TestThreadPoolNestedParallelFor() {
+    ThreadPool pool(2);
+    vector<atomic<int>> counts(64);
+    pool.ParallelFor(8, [&](size_t i) {
+        pool.ParallelFor(8, [&](size_t j) {
+            ++counts[i * 8 + j];
+        });
+    });
+    ASSERT(all_of(counts.begin(), counts.end(), [](const atomic<int>& count) {
+        return count.load() == 1;
+    }));
+
+    bool failed = false;
+    try {
+        pool.ParallelFor(100, [](size_t i) {
+            if (i == 57) {
+                throw out_of_range("57"s);
+            }
+        });
+    } catch (const out_of_range&) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+// Асинхронный поиск возвращает ту же выдачу, а запрос, отменённый до начала, бросает QueryCancelled из future
+void TestAsyncSearchMatchesSequential() {
+    const SearchFixture fixture;
+    ThreadPool pool(2);
+    ForEachIndexState(fixture, [&fixture, &pool](const SearchServer& server, const ExpectedResults& expected, IndexState state) {
+        vector<future<vector<Document>>> results;
+        for (const string& query : fixture.queries) {
+            for (const DocumentStatus status : fixture.statuses) {
+                results.push_back(server.FindTopDocumentsAsync(pool, query, status));
+            }
+        }
+        size_t i = 0;
+        for (const string& query : fixture.queries) {
+            for (const DocumentStatus status : fixture.statuses) {
+                AssertSameDocuments(results[i++].get(), expected.at({query, status}), GetStateName(state) + " async: "s + query);
+            }
+        }
+
+        QueryOptions cancelled;
+        cancelled.cancellation = CancellationToken::Create();
+        cancelled.cancellation.Cancel();
+        auto result = server.FindTopDocumentsAsync(pool, fixture.queries[0], cancelled);
+        bool thrown = false;
+        try {
+            result.get();
+        } catch (const QueryCancelled&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+}
+
+// Арена возвращает исходные тексты живых документов и пустую строку для удалённых,
+// в том числе после сжатия индекса и переписывания арены
+void TestDocumentTextsSurviveCompaction() {
+    const SearchFixture fixture;
+    ForEachIndexState(fixture, [&fixture](SearchServer& server, const ExpectedResults&, IndexState state) {
+        if (state == IndexState::COMPACTED) {
+            server.CompactDocumentTexts();
+        }
+        const set<int> removed(fixture.removed_ids.begin(), fixture.removed_ids.end());
+        for (const NewDocument& document : fixture.documents) {
+            const bool is_removed = state != IndexState::ADDED && removed.count(document.id) > 0;
+            const string hint = GetStateName(state) + " text "s + to_string(document.id);
+            ASSERT_HINT(server.GetDocumentText(document.id) == (is_removed ? ""sv : document.text), hint);
+        }
+        ASSERT(server.GetDocumentText(-1).empty());
+    });
+}
+
+}  // namespace
+
+void TestSearchServer() {
+    TestRunner tr;
+    RUN_TEST(tr, TestRemovedWordDoesNotPoisonCachedPair);
+    RUN_TEST(tr, TestRemoveAndCompactMatchReference);
+    RUN_TEST(tr, TestRemoveDocumentDoesNotCompactByDefault);
+    RUN_TEST(tr, TestRangeShardsMatchExhaustiveSearch);
+    RUN_TEST(tr, TestThreadLocalPoolHandsOutFreeObjects);
+    RUN_TEST(tr, TestReentrantQueryKeepsOuterState);
+    RUN_TEST(tr, TestCancelledQueryStopsWhileCollectingExclusions);
+    RUN_TEST(tr, TestBatchMatchesSingleQueries);
+    RUN_TEST(tr, TestBatchSpansDocumentTiles);
+    RUN_TEST(tr, TestPostingCacheMatchesUncachedSearch);
+    RUN_TEST(tr, TestPostingCacheAdmitsPairAfterFirstWord);
+    RUN_TEST(tr, TestSnapshotMatchesSavedIndex);
+    RUN_TEST(tr, TestCorruptedSnapshotPostingsThrowOnFirstUse);
+    RUN_TEST(tr, TestSegmentedIndexMatchesReference);
+    RUN_TEST(tr, TestCompressedPostingsMatchPlain);
+    RUN_TEST(tr, TestTopKIsPrefixOfAllDocuments);
+    RUN_TEST(tr, TestScoreAccumulatorMatchesMap);
+    RUN_TEST(tr, TestParallelByWordsMatchesSequential);
+    RUN_TEST(tr, TestMaxScoreMatchesExhaustive);
+    RUN_TEST(tr, TestStatusBitmapMatchesLambdaPredicate);
+    RUN_TEST(tr, TestResultCacheMatchesUncachedSearch);
+    RUN_TEST(tr, TestAddDocumentsMatchesAddDocument);
+    RUN_TEST(tr, TestThreadPoolPolicyMatchesSequential);
+    RUN_TEST(tr, TestThreadPoolNestedParallelFor);
+    RUN_TEST(tr, TestAsyncSearchMatchesSequential);
+    RUN_TEST(tr, TestDocumentTextsSurviveCompaction);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Тесты поисковой системы; упавший тест завершает программу
+void TestSearchServer();
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Проверки бросают исключение с описанием, а TestRunner считает упавшие тесты
+// и завершает программу с ошибкой, если такие были
+template <typename T, typename U>
+void AssertEqual(const T& t, const U& u, const string& hint = {}) {
+    if (!(t == u)) {
+        ostringstream os;
+        os << "Assertion failed: "s << t << " != "s << u;
+        if (!hint.empty()) {
+            os << " hint: "s << hint;
+        }
+        throw runtime_error(os.str());
+    }
+}
+
+inline void Assert(bool value, const string& hint) {
+    AssertEqual(value, true, hint);
+}
+
+class TestRunner {
+public:
+    template <typename TestFunc>
+    void RunTest(TestFunc func, const string& test_name) {
+        try {
+            func();
+            cerr << test_name << " OK"s << endl;
+        } catch (const exception& e) {
+            ++fail_count_;
+            cerr << test_name << " fail: "s << e.what() << endl;
+        } catch (...) {
+            ++fail_count_;
+            cerr << "Unknown exception caught"s << endl;
+        }
+    }
+
+    ~TestRunner() {
+        cerr.flush();
+        if (fail_count_ > 0) {
+            cerr << fail_count_ << " unit tests failed. Terminate"s << endl;
+            exit(1);
+        }
+    }
+
+private:
+    int fail_count_ = 0;
+};
+
+#define ASSERT_EQUAL(x, y)                                                              \
+    {                                                                                   \
+        ostringstream assert_equal_private_os;                                          \
+        assert_equal_private_os << #x << " != "s << #y << ", "s << __FILE__ << ":"s << __LINE__; \
+        AssertEqual(x, y, assert_equal_private_os.str());                               \
+    }
+
+#define ASSERT(x)                                                             \
+    {                                                                         \
+        ostringstream assert_private_os;                                      \
+        assert_private_os << #x << " is false, "s << __FILE__ << ":"s << __LINE__; \
+        Assert(!!(x), assert_private_os.str());                               \
+    }
+
+#define ASSERT_HINT(x, hint)                                                  \
+    {                                                                         \
+        ostringstream assert_private_os;                                      \
+        assert_private_os << #x << " is false, "s << __FILE__ << ":"s << __LINE__ << ": "s << (hint); \
+        Assert(!!(x), assert_private_os.str());                               \
+    }
+
+#define RUN_TEST(tr, func) tr.RunTest(func, #func)
@@ -0,0 +1,86 @@
+#include "text_arena.h"
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+TextArena::TextArena(const TextArena& other) {
+    *this = other;
+}
+
+TextArena& TextArena::operator=(const TextArena& other) {
+    if (this == &other) {
+        return *this;
+    }
+    chunks_.clear();
+    chunks_.reserve(other.chunks_.size());
+    for (const Chunk& chunk : other.chunks_) {
+        if (!chunk.owned) {
+            chunks_.push_back({nullptr, chunk.data, chunk.size, chunk.capacity});
+            continue;
+        }
+        unique_ptr<char[]> owned(new char[chunk.capacity]);
+        memcpy(owned.get(), chunk.data, chunk.size);
+        const char* data = owned.get();
+        chunks_.push_back({move(owned), data, chunk.size, chunk.capacity});
+    }
+    return *this;
+}
+
+uint64_t TextArena::Append(string_view text) {
+    if (text.size() > numeric_limits<uint32_t>::max()) {
+        throw length_error("Document text is too long"s);
+    }
+    if (chunks_.empty() || !chunks_.back().owned || chunks_.back().capacity - chunks_.back().size < text.size()) {
+        // текст длиннее куска получает собственный кусок
+        const size_t capacity = max(TEXT_ARENA_CHUNK_SIZE, text.size());
+        unique_ptr<char[]> owned(new char[capacity]);
+        const char* data = owned.get();
+        chunks_.push_back({move(owned), data, 0, capacity});
+    }
+    Chunk& chunk = chunks_.back();
+    const uint64_t offset = (static_cast<uint64_t>(chunks_.size() - 1) << 32) | chunk.size;
+    memcpy(chunk.owned.get() + chunk.size, text.data(), text.size());
+    chunk.size += text.size();
+    return offset;
+}
+
+size_t TextArena::GetUsedSize() const {
+    size_t size = 0;
+    for (const Chunk& chunk : chunks_) {
+        size += chunk.size;
+    }
+    return size;
+}
+
+void TextArena::Save(SnapshotWriter& writer) const {
+    vector<uint64_t> chunk_sizes;
+    chunk_sizes.reserve(chunks_.size());
+    writer.BeginSection(SnapshotSection::DOCUMENT_TEXT_CHARS);
+    for (const Chunk& chunk : chunks_) {
+        chunk_sizes.push_back(chunk.size);
+        writer.Write(chunk.data, chunk.size);
+    }
+    writer.EndSection();
+    writer.WriteSection(SnapshotSection::TEXT_CHUNK_SIZES, chunk_sizes.data(), chunk_sizes.size());
+}
+
+void TextArena::Load(const SnapshotReader& reader) {
+    const string_view chars = reader.GetSection(SnapshotSection::DOCUMENT_TEXT_CHARS);
+    const auto chunk_sizes = reader.GetArray<uint64_t>(SnapshotSection::TEXT_CHUNK_SIZES);
+    chunks_.clear();
+    chunks_.reserve(chunk_sizes.size());
+    size_t begin = 0;
+    for (const uint64_t size : chunk_sizes) {
+        if (size > chars.size() - begin) {
+            throw runtime_error("Snapshot text chunks are corrupted"s);
+        }
+        // отображённый кусок заполнен: capacity равна size, и дописывать в него нельзя
+        chunks_.push_back({nullptr, chars.data() + begin, size, size});
+        begin += size;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+const size_t TEXT_ARENA_CHUNK_SIZE = 1 << 20;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Тексты документов, сложенные подряд в большие куски памяти.
+// Куски никогда не перемещаются, поэтому string_view на тексты остаются
+// валидными, пока арену не уплотнили. Адрес текста: номер куска в старших
+// 32 битах и смещение внутри куска в младших
+class TextArena {
+public:
+    TextArena() = default;
+
+    TextArena(const TextArena& other);
+    TextArena& operator=(const TextArena& other);
+
+    TextArena(TextArena&&) = default;
+    TextArena& operator=(TextArena&&) = default;
+
+    uint64_t Append(string_view text);
+
+    string_view Get(uint64_t offset, uint32_t length) const {
+        return {chunks_[offset >> 32].data + (offset & 0xFFFFFFFFu), length};
+    }
+
+    // Лежит ли текст с таким адресом целиком в одном куске
+    bool Contains(uint64_t offset, uint32_t length) const {
+        const size_t chunk = offset >> 32;
+        const size_t chunk_offset = offset & 0xFFFFFFFFu;
+        return chunk < chunks_.size() && chunk_offset <= chunks_[chunk].size && length <= chunks_[chunk].size - chunk_offset;
+    }
+
+    // Байты, занятые текстами, включая тексты удалённых документов
+    size_t GetUsedSize() const;
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Куски смотрят прямо в отображённый файл, новые тексты пишутся в новые куски
+    void Load(const SnapshotReader& reader);
+
+private:
+    struct Chunk {
+        unique_ptr<char[]> owned;
+        const char* data;
+        size_t size;
+        size_t capacity;
+    };
+
+    vector<Chunk> chunks_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Объекты, которые поток переиспользует от запроса к запросу, чтобы не выделять память заново.
+// Объект принадлежит запросу, пока жива его Lease. Поток, который ждёт параллельную часть
+// своего запроса, может взяться за чужую задачу: та получит другой объект, а не занятый
+template <typename T>
+class ThreadLocalPool {
+public:
+    class Lease {
+    public:
+        Lease(Lease&& other) = default;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease() {
+            if (object_) {
+                free_objects_->push_back(move(object_));
+            }
+        }
+
+        T& operator*() const {
+            return *object_;
+        }
+
+        T* operator->() const {
+            return object_.get();
+        }
+
+    private:
+        friend class ThreadLocalPool;
+
+        // объект возвращается в список потока, который его выдал
+        vector<unique_ptr<T>>* free_objects_;
+        unique_ptr<T> object_;
+
+        explicit Lease(vector<unique_ptr<T>>& free_objects)
+            : free_objects_(&free_objects) {
+            if (free_objects.empty()) {
+                object_ = make_unique<T>();
+            } else {
+                object_ = move(free_objects.back());
+                free_objects.pop_back();
+            }
+        }
+    };
+
+    // Свободный объект текущего потока или новый, если все заняты. Lease освобождается в том же потоке
+    static Lease Acquire() {
+        thread_local vector<unique_ptr<T>> free_objects;
+        return Lease(free_objects);
+    }
+};
@@ -0,0 +1,137 @@
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// пул и номер потока, если текущий поток принадлежит пулу
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t thread_count, bool pin_threads) {
+    const size_t core_count = max(1u, thread::hardware_concurrency());
+    if (thread_count == 0) {
+        thread_count = core_count;
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+#ifdef __linux__
+        if (pin_threads) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % core_count, &cpus);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::GetShared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Submit(function<void()> task) {
+    const size_t index = current_pool == this ? current_worker : next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+    // счётчик растёт до постановки, чтобы не уйти в минус, если задачу заберут сразу
+    queued_count_.fetch_add(1);
+    {
+        lock_guard<mutex> lock(queues_[index]->m);
+        queues_[index]->tasks.push_back(move(task));
+    }
+    {
+        // пустой захват: поток, проверивший счётчик до увеличения, уже ждёт и получит сигнал
+        lock_guard<mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t index, function<void()>& task) {
+    {
+        WorkerQueue& own = *queues_[index];
+        lock_guard<mutex> lock(own.m);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = *queues_[(index + offset) % queues_.size()];
+        lock_guard<mutex> lock(victim.m);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    function<void()> task;
+    while (true) {
+        if (TryPop(index, task)) {
+            queued_count_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock<mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || queued_count_.load() > 0;
+        });
+        if (stopping_ && queued_count_.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::RunChunks(RangeState& state) {
+    while (true) {
+        const size_t chunk = state.next_chunk.fetch_add(1);
+        if (chunk >= state.chunk_count) {
+            return;
+        }
+        // после ошибки оставшиеся части только отмечаются выполненными
+        if (!state.failed.load(memory_order_relaxed)) {
+            try {
+                state.run_range(state.count * chunk / state.chunk_count, state.count * (chunk + 1) / state.chunk_count);
+            } catch (...) {
+                lock_guard<mutex> lock(state.m);
+                if (!state.failed.exchange(true)) {
+                    state.error = current_exception();
+                }
+            }
+        }
+        if (state.done_chunks.fetch_add(1) + 1 == state.chunk_count) {
+            lock_guard<mutex> lock(state.m);
+            state.all_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent_map.h"
+
+using namespace std;
+
+// Пул потоков с очередью у каждого потока. Поток берёт задачи из своей очереди
+// с конца, а когда она пуста, крадёт из чужих с начала.
+// Задачи, поставленные из потока пула, попадают в его собственную очередь
+class ThreadPool {
+public:
+    // thread_count == 0 — по числу ядер. pin_threads закрепляет i-й поток за i-м ядром (только Linux)
+    explicit ThreadPool(size_t thread_count = 0, bool pin_threads = false);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Дожидается выполнения поставленных задач
+    ~ThreadPool();
+
+    size_t GetThreadCount() const {
+        return workers_.size();
+    }
+
+    // Пул, общий для всех серверов процесса
+    static ThreadPool& GetShared();
+
+    // Задача не должна бросать исключений
+    void Submit(function<void()> task);
+
+    // Вызывает function(i) для каждого i из [0, count) и ждёт завершения.
+    // Вызывающий поток тоже выполняет части диапазона, но чужих задач не берёт,
+    // поэтому вложенные вызовы из потоков пула не блокируются.
+    // Первое брошенное исключение передаётся вызывающему
+    template <typename Function>
+    void ParallelFor(size_t count, Function function);
+
+private:
+    struct alignas(CACHE_LINE_SIZE) WorkerQueue {
+        mutex m;
+        deque<function<void()>> tasks;
+    };
+
+    // Общее состояние одного ParallelFor. Задачи держат его через shared_ptr
+    // и могут запуститься уже после возврата: тогда частей для них не остаётся
+    struct RangeState {
+        size_t count = 0;
+        size_t chunk_count = 0;
+        function<void(size_t, size_t)> run_range;
+        atomic<size_t> next_chunk{0};
+        atomic<size_t> done_chunks{0};
+        atomic<bool> failed{false};
+        exception_ptr error;
+        mutex m;
+        condition_variable all_done;
+    };
+
+    vector<unique_ptr<WorkerQueue>> queues_;
+    vector<thread> workers_;
+    atomic<size_t> queued_count_{0};
+    atomic<size_t> next_queue_{0};
+    mutex sleep_mutex_;
+    condition_variable wake_;
+    bool stopping_ = false;
+
+    void WorkerLoop(size_t index);
+
+    bool TryPop(size_t index, function<void()>& task);
+
+    static void RunChunks(RangeState& state);
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function) {
+    if (count == 0) {
+        return;
+    }
+    auto state = make_shared<RangeState>();
+    state->count = count;
+    // частей больше, чем потоков, чтобы неравные части выравнивались между потоками
+    state->chunk_count = min(count, (workers_.size() + 1) * 4);
+    state->run_range = [&function](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            function(i);
+        }
+    };
+
+    const size_t helper_count = min(workers_.size(), state->chunk_count - 1);
+    for (size_t i = 0; i < helper_count; ++i) {
+        Submit([state] {
+            RunChunks(*state);
+        });
+    }
+    RunChunks(*state);
+
+    {
+        unique_lock<mutex> lock(state->m);
+        state->all_done.wait(lock, [&state] {
+            return state->done_chunks.load() == state->chunk_count;
+        });
+    }
+    if (state->error) {
+        rethrow_exception(state->error);
+    }
+}
+
+// Аналог политики выполнения: алгоритмы сервера выполняются в заданном пуле
+class ThreadPoolPolicy {
+public:
+    explicit ThreadPoolPolicy(ThreadPool& pool)
+        : pool_(&pool) {
+    }
+
+    ThreadPool& GetPool() const {
+        return *pool_;
+    }
+
+private:
+    ThreadPool* pool_;
+};
+
+template <typename ExecutionPolicy>
+inline constexpr bool IS_THREAD_POOL_POLICY = is_same_v<decay_t<ExecutionPolicy>, ThreadPoolPolicy>;
+
+// Сколько потоков может работать по политике одновременно
+template <typename ExecutionPolicy>
+size_t GetParallelism(const ExecutionPolicy& policy) {
+    if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+        return policy.GetPool().GetThreadCount() + 1;
+    } else if constexpr (is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        return 1;
+    } else {
+        return max(1u, thread::hardware_concurrency());
+    }
+}
+
+// for_each по диапазону с произвольным доступом, который понимает и стандартные политики, и пул.
+// Исключение из function передаётся вызывающему: стандартный for_each с политикой
+// в этом случае вызвал бы terminate
+template <typename ExecutionPolicy, typename Iterator, typename Function>
+void ParallelForEach(ExecutionPolicy&& policy, Iterator begin, Iterator end, Function function) {
+    if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+        policy.GetPool().ParallelFor(end - begin, [&](size_t i) {
+            function(begin[i]);
+        });
+    } else {
+        mutex error_mutex;
+        exception_ptr error;
+        for_each(policy, begin, end, [&](auto& item) {
+            try {
+                function(item);
+            } catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        });
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+
+using namespace std;
+
+// Ниже этого размера параллельный отбор не окупает запуск потоков
+const size_t PARALLEL_TOP_K_THRESHOLD = 1 << 14;
+
+// Оставляет в items count лучших элементов, упорядоченных по is_better.
+// partial_sort держит кучу из count элементов, поэтому стоимость O(n log count), а не O(n log n)
+template <typename T, typename Compare>
+void SelectTop(vector<T>& items, size_t count, Compare is_better) {
+    if (items.size() > count) {
+        partial_sort(items.begin(), items.begin() + count, items.end(), is_better);
+        items.resize(count);
+    } else {
+        sort(items.begin(), items.end(), is_better);
+    }
+}
+
+// Параллельный вариант: каждый поток отбирает count лучших в своей части,
+// затем лучшие из частей сливаются и отбираются ещё раз
+template <typename ExecutionPolicy, typename T, typename Compare>
+void SelectTop(ExecutionPolicy&& policy, vector<T>& items, size_t count, Compare is_better) {
+    if constexpr (is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        SelectTop(items, count, is_better);
+    } else {
+        const size_t part_count = GetParallelism(policy);
+        if (items.size() < PARALLEL_TOP_K_THRESHOLD || items.size() <= count || part_count == 1) {
+            SelectTop(items, count, is_better);
+            return;
+        }
+
+        const size_t part_size = (items.size() + part_count - 1) / part_count;
+        vector<vector<T>> part_tops(part_count);
+        vector<size_t> parts(part_count);
+        for (size_t i = 0; i < part_count; ++i) {
+            parts[i] = i;
+        }
+        ParallelForEach(policy, parts.begin(), parts.end(), [&](size_t part) {
+            const auto begin = items.begin() + min(items.size(), part * part_size);
+            const auto end = items.begin() + min(items.size(), (part + 1) * part_size);
+            vector<T>& top = part_tops[part];
+            top.resize(min(count, static_cast<size_t>(end - begin)));
+            partial_sort_copy(begin, end, top.begin(), top.end(), is_better);
+        });
+
+        vector<T> merged;
+        merged.reserve(part_count * count);
+        for (const vector<T>& top : part_tops) {
+            merged.insert(merged.end(), top.begin(), top.end());
+        }
+        SelectTop(merged, count, is_better);
+        items = move(merged);
+    }
+}
@@ -0,0 +1,26 @@
+#include "document_fingerprint.h"
+
+using namespace std;
+
+namespace {
+
+// перемешивание из splitmix64: близкие состояния FNV дают далёкие хеши
+uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+}  // namespace
+
+void DocumentFingerprint::AddWord(const string& word) {
+    // две независимые половины: FNV-1a с разными началом и множителем
+    uint64_t word_high = 0xCBF29CE484222325ull;
+    uint64_t word_low = 0x84222325CBF29CE4ull;
+    for (const char c : word) {
+        word_high = (word_high ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        word_low = (word_low ^ static_cast<unsigned char>(c)) * 0x9E3779B97F4A7C15ull;
+    }
+    high += Mix(word_high);
+    low += Mix(word_low);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+
+using namespace std;
+
+// 128-битный отпечаток множества слов документа. Каждое слово добавляется один раз,
+// а хеши слов складываются, поэтому порядок и повторы слов в тексте на отпечаток не влияют
+struct DocumentFingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    void AddWord(const string& word);
+
+    bool operator==(const DocumentFingerprint& other) const {
+        return high == other.high && low == other.low;
+    }
+
+    bool operator<(const DocumentFingerprint& other) const {
+        return tie(high, low) < tie(other.high, other.low);
+    }
+};
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
@@ -3,6 +3,7 @@
 #include "search_server.h"
 #include "log_duration.h"
 #include "remove_duplicates.h"
+#include "test_example_functions.h"
 
 #include <iostream>
 
@@ -41,6 +42,8 @@ void AddDocument(SearchServer& search_server, int document_id, const string& doc
 }
 
 int main() {
+    TestRemoveDuplicates();
+
     SearchServer search_server("and with"s);
 
     AddDocument(search_server, 1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
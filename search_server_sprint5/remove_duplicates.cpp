@@ -1,32 +1,32 @@
-#include <utility>
+#include <unordered_map>
 
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-
-    map<set<string>, int> document_to_word_freqs_;
-    vector<int> id_del;
-    id_del.reserve(search_server.document_ids_.size()-1);
-    int n;
-
-    for(int i = 0; i < search_server.document_ids_.size(); ++i){
-        auto it = search_server.word_to_document_freqs_.begin();
-        set<string> stmp;
-        for(; it != search_server.word_to_document_freqs_.end(); ++it){
-           if(it->second.count(search_server.document_ids_[i])){
-               stmp.insert(it->first);
-           }
-        }
-
-        n = document_to_word_freqs_.size();
-        document_to_word_freqs_.insert(pair<set<string>, int>(stmp, search_server.document_ids_[i]));
-        if(document_to_word_freqs_.size() == n){
-          id_del.push_back(search_server.document_ids_[i]);
+vector<int> FindDuplicates(const SearchServer& search_server) {
+    // первые документы с каждым множеством слов, сгруппированные по отпечаткам
+    unordered_map<DocumentFingerprint, vector<int>, DocumentFingerprintHasher> originals;
+    originals.reserve(search_server.document_ids_.size());
+    vector<int> duplicates;
+    for (const int document_id : search_server.document_ids_) {
+        vector<int>& same_fingerprint = originals[search_server.GetDocumentFingerprint(document_id)];
+        if (any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](int original_id) {
+                return search_server.HasSameWords(document_id, original_id);
+            })) {
+            duplicates.push_back(document_id);
+        } else {
+            same_fingerprint.push_back(document_id);
         }
     }
+    return duplicates;
+}
 
-    for(int i = 0; i<id_del.size(); ++i){
-        cout << "Found duplicate document id " << id_del[i] << endl;
-        search_server.RemoveDocument(id_del[i]);
+void RemoveDuplicates(SearchServer& search_server, const vector<int>& duplicates) {
+    for (const int document_id : duplicates) {
+        cout << "Found duplicate document id " << document_id << endl;
     }
+    search_server.RemoveDocuments(duplicates);
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveDuplicates(search_server, FindDuplicates(search_server));
 }
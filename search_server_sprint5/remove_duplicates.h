@@ -1,5 +1,65 @@
 #pragma once
 
+#include <algorithm>
+#include <execution>
+#include <utility>
+#include <vector>
+
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// Документы с тем же множеством слов, что у добавленного раньше, в порядке добавления.
+// Документы группируются по отпечаткам в хеш-таблице, а внутри группы сравниваются слова,
+// чтобы совпадение отпечатков разных документов не удалило ни один из них
+vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Параллельный вариант: пары (отпечаток, позиция) сортируются по политике,
+// и в каждой группе с одним отпечатком дубликатами оказываются документы,
+// слова которых совпали со словами одного из предыдущих документов группы
+template <typename ExecutionPolicy>
+vector<int> FindDuplicates(ExecutionPolicy&& policy, const SearchServer& search_server) {
+    const vector<int>& document_ids = search_server.document_ids_;
+    vector<pair<DocumentFingerprint, size_t>> fingerprints(document_ids.size());
+    for (size_t position = 0; position < fingerprints.size(); ++position) {
+        fingerprints[position].second = position;
+    }
+    for_each(policy, fingerprints.begin(), fingerprints.end(), [&](pair<DocumentFingerprint, size_t>& fingerprint) {
+        fingerprint.first = search_server.GetDocumentFingerprint(document_ids[fingerprint.second]);
+    });
+    sort(policy, fingerprints.begin(), fingerprints.end());
+
+    vector<size_t> positions;
+    vector<size_t> originals;
+    for (size_t begin = 0, end = 0; begin < fingerprints.size(); begin = end) {
+        while (end < fingerprints.size() && fingerprints[end].first == fingerprints[begin].first) {
+            ++end;
+        }
+        // внутри группы позиции возрастают, и первый документ с данными словами идёт раньше своих дубликатов
+        originals.clear();
+        for (size_t i = begin; i < end; ++i) {
+            const size_t position = fingerprints[i].second;
+            if (any_of(originals.begin(), originals.end(), [&](size_t original) {
+                    return search_server.HasSameWords(document_ids[position], document_ids[original]);
+                })) {
+                positions.push_back(position);
+            } else {
+                originals.push_back(position);
+            }
+        }
+    }
+    sort(policy, positions.begin(), positions.end());
+
+    vector<int> duplicates(positions.size());
+    transform(positions.begin(), positions.end(), duplicates.begin(), [&document_ids](size_t position) {
+        return document_ids[position];
+    });
+    return duplicates;
+}
+
+void RemoveDuplicates(SearchServer& search_server, const vector<int>& duplicates);
+
+void RemoveDuplicates(SearchServer& search_server);
+
+template <typename ExecutionPolicy>
+void RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server) {
+    RemoveDuplicates(search_server, FindDuplicates(policy, search_server));
+}
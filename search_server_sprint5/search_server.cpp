@@ -31,42 +31,61 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return accumulate(ratings.begin(), ratings.end(), rating_sum) / static_cast<int>(ratings.size());
 }
 
+bool SearchServer::HaveSameWords(const map<string, double>& word_freqs, const map<string, double>& other_word_freqs) {
+    return equal(word_freqs.begin(), word_freqs.end(), other_word_freqs.begin(), other_word_freqs.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    });
+}
+
 const map<string, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    static map<string, double> id_frequencies;
-    
-    if(count(document_ids_.begin(), document_ids_.end(), document_id)){
-       
-        auto it = word_to_document_freqs_.begin();
-        for(; it != word_to_document_freqs_.end(); ++it){
-            auto it2 = it->second.find(document_id);
-            if(it2 != it->second.end()){
-               id_frequencies[it->first] =  it2->second;
-            }
+    static const map<string, double> empty_frequencies;
+
+    const auto it = document_to_word_freqs_.find(document_id);
+    if (it == document_to_word_freqs_.end()) {
+        return empty_frequencies;
+    }
+    return it->second;
+}
+
+void SearchServer::EraseDocumentData(int document_id){
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return;
+    }
+    const auto fingerprint_it = fingerprint_documents_.find(document_it->second.fingerprint);
+    vector<int>& same_fingerprint = fingerprint_it->second;
+    same_fingerprint.erase(find(same_fingerprint.begin(), same_fingerprint.end(), document_id));
+    if (same_fingerprint.empty()) {
+        fingerprint_documents_.erase(fingerprint_it);
+    }
+    documents_.erase(document_it);
+
+    for (const auto& [word, _] : document_to_word_freqs_.at(document_id)) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        word_it->second.erase(document_id);
+        if (word_it->second.empty()) {
+            word_to_document_freqs_.erase(word_it);
         }
     }
-    
-    return id_frequencies;
+    document_to_word_freqs_.erase(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id){
-    
-    map<string, map<int, double>> word_to_document_freqs_;
-    
-    documents_.erase(document_id);
-    
-    document_ids_.erase(find(document_ids_.begin(), document_ids_.end(), document_id));
-    
-    auto it = word_to_document_freqs_.begin();
-    for(; it != word_to_document_freqs_.end(); ++it){
-        auto it2 = it->second.find(document_id);
-        if(it2 != it->second.end()){
-            it->second.erase(it2); 
-            if(it->second.size() == 0){
-                word_to_document_freqs_.erase(it);
-            }
-        }
+    if (documents_.count(document_id) == 0) {
+        return;
     }
+    EraseDocumentData(document_id);
+    document_ids_.erase(find(document_ids_.begin(), document_ids_.end(), document_id));
+}
 
+void SearchServer::RemoveDocuments(const vector<int>& document_ids){
+    const set<int> removed(document_ids.begin(), document_ids.end());
+    for (const int document_id : removed) {
+        EraseDocumentData(document_id);
+    }
+    document_ids_.erase(remove_if(document_ids_.begin(), document_ids_.end(), [&removed](int document_id) {
+        return removed.count(document_id) > 0;
+    }), document_ids_.end());
 }
 
 void SearchServer::AddDocument(int document_id, const string& document, DocumentStatus status, const vector<int>& ratings) {
@@ -76,10 +95,31 @@ void SearchServer::AddDocument(int document_id, const string& document, Document
         const auto words = SplitIntoWordsNoStop(document);
 
         const double inv_word_count = 1.0 / words.size();
+        map<string, double> word_freqs;
         for (const string& word : words) {
-            word_to_document_freqs_[word][document_id] += inv_word_count;
+            word_freqs[word] += inv_word_count;
+        }
+        DocumentFingerprint fingerprint;
+        for (const auto& [word, _] : word_freqs) {
+            fingerprint.AddWord(word);
+        }
+        if (reject_duplicates_) {
+            const auto fingerprint_it = fingerprint_documents_.find(fingerprint);
+            // разные множества слов с одним отпечатком маловероятны, но дубликатом их не считаем
+            if (fingerprint_it != fingerprint_documents_.end()
+                && any_of(fingerprint_it->second.begin(), fingerprint_it->second.end(), [&](int other_document_id) {
+                       return HaveSameWords(word_freqs, document_to_word_freqs_.at(other_document_id));
+                   })) {
+                throw invalid_argument("Document is a duplicate"s);
+            }
+        }
+
+        for (const auto& [word, term_freq] : word_freqs) {
+            word_to_document_freqs_[word][document_id] = term_freq;
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+        document_to_word_freqs_.emplace(document_id, move(word_freqs));
+        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, fingerprint});
+        fingerprint_documents_[fingerprint].push_back(document_id);
         document_ids_.push_back(document_id);
 }
 
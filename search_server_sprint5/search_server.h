@@ -1,10 +1,12 @@
 #pragma once
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 
 #include "document.h"
 #include "string_processing.h"
+#include "document_fingerprint.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
@@ -19,6 +21,9 @@ public:
     
     void RemoveDocument(int document_id);
 
+    // Удаляет документы одним проходом по document_ids_
+    void RemoveDocuments(const vector<int>& document_ids);
+
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
 
@@ -27,6 +32,22 @@ public:
 
     void AddDocument(int document_id, const string& document, DocumentStatus status, const vector<int>& ratings);
 
+    // AddDocument бросает invalid_argument для документа с тем же множеством слов, что у уже добавленного.
+    // Совпадение отпечатков проверяется сравнением самих слов
+    void SetRejectDuplicates(bool enabled) {
+        reject_duplicates_ = enabled;
+    }
+
+    // Отпечаток множества слов документа, посчитанный при добавлении
+    DocumentFingerprint GetDocumentFingerprint(int document_id) const {
+        return documents_.at(document_id).fingerprint;
+    }
+
+    // Одинаковы ли множества слов документов; нужно, когда совпали отпечатки
+    bool HasSameWords(int document_id, int other_document_id) const {
+        return HaveSameWords(document_to_word_freqs_.at(document_id), document_to_word_freqs_.at(other_document_id));
+    }
+
 
     template <typename DocumentPredicate>
     vector<Document> FindTopDocuments(const string& raw_query, DocumentPredicate document_predicate) const;
@@ -53,9 +74,18 @@ private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        DocumentFingerprint fingerprint;
     };
     const set<string> stop_words_;
     map<int, DocumentData> documents_;
+    // слова каждого документа с их TF
+    map<int, map<string, double>> document_to_word_freqs_;
+    // документы с каждым отпечатком
+    unordered_map<DocumentFingerprint, vector<int>, DocumentFingerprintHasher> fingerprint_documents_;
+    bool reject_duplicates_ = false;
+
+    // Убирает документ отовсюду, кроме document_ids_
+    void EraseDocumentData(int document_id);
 
     bool IsStopWord(const string& word) const;
 
@@ -65,6 +95,8 @@ private:
 
     static int ComputeAverageRating(const vector<int>& ratings);
 
+    static bool HaveSameWords(const map<string, double>& word_freqs, const map<string, double>& other_word_freqs);
+
     const map<string, double>& GetWordFrequencies(int document_id) const;
 
     struct QueryWord {
@@ -0,0 +1,83 @@
+#include "test_example_functions.h"
+
+#include <cassert>
+#include <execution>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "log_duration.h"
+
+using namespace std;
+
+namespace {
+
+// Документы из слов маленького словаря: множества слов часто повторяются
+string GenerateDocument(mt19937& generator, int word_count) {
+    string document;
+    for (int i = 0; i < word_count; ++i) {
+        document += "w"s + to_string(uniform_int_distribution(0, 7)(generator)) + " "s;
+    }
+    return document;
+}
+
+void TestParallelFindDuplicatesMatchesSequential() {
+    mt19937 generator(25);
+    SearchServer search_server("w0"s);
+    for (int document_id = 0; document_id < 20000; ++document_id) {
+        search_server.AddDocument(document_id * 3, GenerateDocument(generator, uniform_int_distribution(1, 6)(generator)),
+                                  DocumentStatus::ACTUAL, {1});
+    }
+
+    vector<int> sequential;
+    {
+        LOG_DURATION("FindDuplicates"s, cerr);
+        sequential = FindDuplicates(search_server);
+    }
+    vector<int> parallel;
+    {
+        LOG_DURATION("FindDuplicates par"s, cerr);
+        parallel = FindDuplicates(execution::par, search_server);
+    }
+    assert(!sequential.empty());
+    assert(parallel == sequential);
+    assert(FindDuplicates(execution::seq, search_server) == sequential);
+
+    search_server.RemoveDocuments(parallel);
+    assert(FindDuplicates(search_server).empty());
+}
+
+void TestRejectDuplicates() {
+    SearchServer search_server("and with"s);
+    search_server.SetRejectDuplicates(true);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+
+    bool rejected = false;
+    try {
+        search_server.AddDocument(3, "rat nasty and pet funny funny"s, DocumentStatus::ACTUAL, {1, 2});
+    } catch (const invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+    assert(search_server.GetDocumentCount() == 2);
+
+    // новое слово: не дубликат
+    search_server.AddDocument(4, "funny pet and very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+
+    // после удаления исходного документа то же множество слов снова можно добавить
+    search_server.RemoveDocument(1);
+    search_server.AddDocument(5, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    assert(search_server.GetDocumentCount() == 3);
+}
+
+}  // namespace
+
+void TestRemoveDuplicates() {
+    TestParallelFindDuplicatesMatchesSequential();
+    TestRejectDuplicates();
+    cerr << "TestRemoveDuplicates OK"s << endl;
+}
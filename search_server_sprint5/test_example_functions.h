@@ -1 +1,5 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+// Поиск дубликатов: параллельный вариант находит те же документы, что последовательный,
+// а SetRejectDuplicates не пускает документ с уже добавленным множеством слов
+void TestRemoveDuplicates();